@@ -0,0 +1,360 @@
+#include "config.h"
+#include "iou.h"
+#include "trace.h"
+#include "verify.h"
+#include "pipeline.h"
+#include <functional>
+#include <iomanip>
+#include <memory>
+
+// Small in-house harness for the per-I/O hot paths of the engines.
+// Each case runs a body repeatedly, calibrating the batch size until a batch
+// takes at least min_batch_ns, and reports the median and minimum ns per op
+// over several batches.
+//
+// Usage: io_microbench [filter]   (only run cases whose name contains filter)
+
+static constexpr uint64_t min_batch_ns = 20 * KILO * KILO; // 20ms
+static constexpr int repetitions = 7;
+
+template <typename T>
+inline void do_not_optimize(T const &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct bench_case
+{
+    std::string name;
+    uint64_t ops_per_call; // logical operations performed by one call of the body
+    std::function<void()> body;
+};
+
+static void run_case(const bench_case &bc)
+{
+    uint64_t iterations = 1;
+
+    // Calibrate: grow the batch until it is long enough to time reliably
+    while (true)
+    {
+        uint64_t start = get_current_time_ns();
+        for (uint64_t i = 0; i < iterations; i++)
+        {
+            bc.body();
+        }
+        if (get_current_time_ns() - start >= min_batch_ns || iterations >= (1ULL << 32))
+        {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    std::vector<double> ns_per_op(repetitions);
+    for (int r = 0; r < repetitions; r++)
+    {
+        uint64_t start = get_current_time_ns();
+        for (uint64_t i = 0; i < iterations; i++)
+        {
+            bc.body();
+        }
+        uint64_t elapsed = get_current_time_ns() - start;
+        ns_per_op[r] = double(elapsed) / double(iterations * bc.ops_per_call);
+    }
+
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+    double median = ns_per_op[repetitions / 2];
+
+    std::cout << std::left << std::setw(40) << bc.name
+              << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << median
+              << std::setw(12) << ns_per_op.front()
+              << std::setw(14) << 1e3 / median << std::endl;
+}
+
+// A fixed free list with only the last slot free is the worst case for the linear scan
+static void add_acquire_buffer_cases(std::vector<bench_case> &cases)
+{
+    for (uint64_t queue_depth : {1, 32, 256})
+    {
+        auto is_buffer_free = std::make_shared<std::vector<char>>(queue_depth, false);
+        cases.push_back({"acquire_buffer/qd" + std::to_string(queue_depth) + "/last_free", 1, [=]() {
+                             bool *free_list = reinterpret_cast<bool *>(is_buffer_free->data());
+                             free_list[queue_depth - 1] = true;
+                             uint32_t id = acquire_buffer(free_list, queue_depth);
+                             do_not_optimize(id);
+                         }});
+    }
+}
+
+static void add_user_data_cases(std::vector<bench_case> &cases)
+{
+    auto counter = std::make_shared<uint32_t>(0);
+    cases.push_back({"combine32To64+extractBoth32", 1, [=]() {
+                         uint32_t n = (*counter)++;
+                         uint64_t user_data = combine32To64(n & 0xff, n);
+                         do_not_optimize(user_data);
+                         auto [buffer_id, request_id] = extractBoth32(user_data);
+                         do_not_optimize(buffer_id);
+                         do_not_optimize(request_id);
+                     }});
+}
+
+static void add_generate_offsets_cases(std::vector<bench_case> &cases)
+{
+    static constexpr uint64_t offsets_per_call = 1 << 16;
+
+    for (const char *method : {"seq", "rand"})
+    {
+        auto params = std::make_shared<benchmark_params>();
+        params->seq_or_rand = method;
+        params->io = offsets_per_call;
+        params->device_size = 512 * KIBI * KIBI * KIBI; // 512 GiB
+        params->region_size = params->device_size;
+        params->total_num_pages = params->device_size / params->page_size;
+
+        cases.push_back({std::string("generate_offsets/") + method, offsets_per_call, [=]() {
+                             std::vector<uint64_t> offsets = generate_offsets(*params, 1);
+                             do_not_optimize(offsets.data());
+                         }});
+    }
+}
+
+// Per-I/O bookkeeping done by the sync engine and read by the stats thread
+static void add_stats_cases(std::vector<bench_case> &cases)
+{
+    cases.push_back({"get_current_time_ns", 1, []() {
+                         uint64_t now = get_current_time_ns();
+                         do_not_optimize(now);
+                     }});
+
+    auto stats = std::make_shared<thread_stats>();
+    stats->latencies.resize(1 << 20, 0);
+    cases.push_back({"stats/record_latency", 1, [=]() {
+                         uint64_t start = get_current_time_ns();
+                         stats->io_completed++;
+                         stats->latencies[stats->io_completed & ((1 << 20) - 1)] = get_current_time_ns() - start;
+                         do_not_optimize(stats->io_completed);
+                     }});
+
+    auto histogram = std::make_shared<latency_histogram>();
+    auto counter = std::make_shared<uint64_t>(0);
+    cases.push_back({"stats/histogram_record", 1, [=]() {
+                         // spread values over several octaves so the bucket math is exercised
+                         histogram->record(1000 + ((*counter)++ * 2654435761ULL) % (1 << 20));
+                     }});
+
+    // --outliers: a full heap of 100, so nearly every call is the single threshold compare
+    auto outliers = std::make_shared<outlier_heap>();
+    outliers->init(100, 0);
+    cases.push_back({"stats/record_outlier", 1, [=]() {
+                         uint64_t latency = 1000 + ((*counter)++ * 2654435761ULL) % (1 << 20);
+                         record_outlier(*outliers, TRACE_OP_READ, 4096, 4096, 1000, latency, 1);
+                     }});
+
+    // The flusher is not running, so reset the ring by hand to keep it from filling up
+    struct ring_with_records
+    {
+        trace_ring ring;
+        std::vector<trace_record> records = std::vector<trace_record>(1 << 16);
+    };
+    auto trace = std::make_shared<ring_with_records>();
+    trace->ring.mask = trace->records.size() - 1;
+    trace->ring.records = trace->records.data();
+    cases.push_back({"trace_push", 1, [=]() {
+                         trace_ring *ring = &trace->ring;
+                         trace_push(ring, TRACE_OP_READ, 4096, 4096, 1000, 2000, 4096);
+                         ring->head.store(ring->tail.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                     }});
+}
+
+// --verify: checksum of one 4 KiB block, the per-I/O cost on top of the stamp itself
+static void add_verify_cases(std::vector<bench_case> &cases)
+{
+    auto block = std::make_shared<std::vector<char>>(4096);
+    std::mt19937_64 rng(42);
+    for (auto &byte : *block)
+    {
+        byte = static_cast<char>(rng());
+    }
+    auto sink = std::make_shared<uint64_t>(0);
+    cases.push_back({"verify/crc32c/4k", 1, [=]() { *sink += crc32c(block->data(), block->size()); }});
+    cases.push_back({"verify/xxh3/4k", 1, [=]() { *sink += xxh3_64(block->data(), block->size()); }});
+}
+
+// --pipeline: one buffer handed to the compute stage and back, uncontended
+static void add_pipeline_cases(std::vector<bench_case> &cases)
+{
+    auto queue = std::make_shared<mpmc_queue<uint32_t>>(64);
+    cases.push_back({"pipeline/mpmc_push+pop", 1, [=]() {
+                         uint32_t value = 0;
+                         queue->try_push(1);
+                         queue->try_pop(value);
+                     }});
+}
+
+// Ring operations against /dev/zero: reads complete inline without touching a device,
+// so the numbers are the software cost of submit_io + io_uring_enter + reap_cqes.
+struct null_ring
+{
+    struct submitter s;
+    int fd = -1;
+    uint64_t queue_depth;
+    std::vector<char *> buffers;
+    std::vector<char> is_buffer_free;
+    std::vector<io_data> io_data_pool;
+    thread_stats stats;
+
+    explicit null_ring(uint64_t qd) : queue_depth(qd), buffers(qd), is_buffer_free(qd, true), io_data_pool(qd)
+    {
+        memset(&s, 0, sizeof(s));
+        fd = open("/dev/zero", O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Error opening /dev/zero: " + std::string(strerror(errno)));
+        }
+        if (app_setup_uring(&s, queue_depth))
+        {
+            throw std::runtime_error("Error setting up io_uring");
+        }
+        for (auto &buffer : buffers)
+        {
+            if (posix_memalign((void **)&buffer, 4096, 4096))
+            {
+                throw std::runtime_error("posix_memalign failed");
+            }
+        }
+    }
+
+    ~null_ring()
+    {
+        for (auto buffer : buffers)
+        {
+            free(buffer);
+        }
+        app_teardown_uring(&s);
+        close(fd);
+    }
+
+    void batch()
+    {
+        bool *free_list = reinterpret_cast<bool *>(is_buffer_free.data());
+        for (uint64_t i = 0; i < queue_depth; i++)
+        {
+            uint32_t buffer_id = acquire_buffer(free_list, queue_depth);
+            submit_io(&s, fd, 4096, 0, true, &io_data_pool[buffer_id], buffers[buffer_id], buffer_id, i);
+        }
+        int ret = io_uring_enter(s.ring_fd, queue_depth, queue_depth, IORING_ENTER_GETEVENTS, NULL);
+        if (ret < 0)
+        {
+            throw std::runtime_error("io_uring_enter failed: " + std::string(strerror(-ret)));
+        }
+        reap_cqes(&s, stats, free_list);
+    }
+};
+
+// Same as null_ring, but through liburing as the liburing engine does
+struct null_liburing
+{
+    struct io_uring ring;
+    int fd = -1;
+    uint64_t queue_depth;
+    std::vector<char *> buffers;
+    std::vector<struct io_uring_cqe *> cqes;
+
+    explicit null_liburing(uint64_t qd) : queue_depth(qd), buffers(qd), cqes(qd)
+    {
+        fd = open("/dev/zero", O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Error opening /dev/zero: " + std::string(strerror(errno)));
+        }
+        if (io_uring_queue_init(queue_depth, &ring, 0) < 0)
+        {
+            throw std::runtime_error("io_uring initialization failed");
+        }
+        for (auto &buffer : buffers)
+        {
+            if (posix_memalign((void **)&buffer, 4096, 4096))
+            {
+                throw std::runtime_error("posix_memalign failed");
+            }
+        }
+    }
+
+    ~null_liburing()
+    {
+        for (auto buffer : buffers)
+        {
+            free(buffer);
+        }
+        io_uring_queue_exit(&ring);
+        close(fd);
+    }
+
+    void batch()
+    {
+        for (uint64_t i = 0; i < queue_depth; i++)
+        {
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+            io_uring_prep_read(sqe, fd, buffers[i], 4096, 0);
+            sqe->user_data = combine32To64(i, i);
+        }
+        io_uring_submit_and_wait(&ring, queue_depth);
+
+        uint64_t reaped = 0;
+        while (reaped < queue_depth)
+        {
+            unsigned count = io_uring_peek_batch_cqe(&ring, cqes.data(), queue_depth);
+            for (unsigned i = 0; i < count; i++)
+            {
+                auto [buffer_id, request_id] = extractBoth32(cqes[i]->user_data);
+                do_not_optimize(buffer_id);
+                io_uring_cqe_seen(&ring, cqes[i]);
+            }
+            reaped += count;
+        }
+    }
+};
+
+static void add_ring_cases(std::vector<bench_case> &cases)
+{
+    for (uint64_t queue_depth : {1, 32})
+    {
+        auto raw = std::make_shared<null_ring>(queue_depth);
+        cases.push_back({"io_uring/null_read/qd" + std::to_string(queue_depth), queue_depth, [=]() { raw->batch(); }});
+
+        auto lib = std::make_shared<null_liburing>(queue_depth);
+        cases.push_back({"liburing/null_read/qd" + std::to_string(queue_depth), queue_depth, [=]() { lib->batch(); }});
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filter = argc > 1 ? argv[1] : "";
+
+    std::vector<bench_case> cases;
+    add_acquire_buffer_cases(cases);
+    add_user_data_cases(cases);
+    add_generate_offsets_cases(cases);
+    add_stats_cases(cases);
+    add_verify_cases(cases);
+    add_pipeline_cases(cases);
+    add_ring_cases(cases);
+
+    pin_thread(0);
+
+    std::cout << std::left << std::setw(40) << "Benchmark"
+              << std::right << std::setw(12) << "ns/op"
+              << std::setw(12) << "min ns/op"
+              << std::setw(14) << "Mops/s" << std::endl;
+
+    for (const auto &bc : cases)
+    {
+        if (bc.name.find(filter) != std::string::npos)
+        {
+            run_case(bc);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -5,4 +5,50 @@
 
 void io_benchmark_thread_async(benchmark_params &params, thread_stats &stats, uint64_t thread_id);
 
-void time_benchmark_thread_async(benchmark_params &params, thread_stats &stats, uint64_t thread_id);
\ No newline at end of file
+void time_benchmark_thread_async(benchmark_params &params, thread_stats &stats, uint64_t thread_id);
+
+void replay_benchmark_thread_async(benchmark_params &params, thread_stats &stats, uint64_t thread_id);
+
+// Setup flags accepted by --setup_flags (IORING_SETUP_*)
+struct uring_support
+{
+    unsigned features = 0;         // IORING_FEAT_* reported for a default ring
+    unsigned setup_flags = 0;      // IORING_SETUP_* flags the kernel accepted
+    bool register_ring_fd = false; // io_uring_register_ring_fd works
+};
+
+/**
+ * @brief Parse a --setup_flags list such as "single_issuer,defer_taskrun".
+ * defer_taskrun adds SINGLE_ISSUER, which the kernel requires with it. defer_taskrun and
+ * coop_taskrun add TASKRUN_FLAG so liburing enters the kernel when completions are pending.
+ * Throws std::invalid_argument for unknown names.
+ */
+unsigned parse_setup_flags(const std::string &spec);
+
+/**
+ * @brief Create the ring of a liburing worker with params.setup_flags and params.cq_entries,
+ * attached to the --attach_wq anchor when params.wq_fd is set, and register its fd when
+ * params.register_ring_fd is set. Exits on failure.
+ *
+ * @param params Benchmark parameters.
+ * @param ring Ring to initialise; must be used only by the calling thread with SINGLE_ISSUER.
+ * @param entries Submission queue entries.
+ */
+void init_liburing_ring(const benchmark_params &params, struct io_uring *ring, unsigned entries);
+
+/**
+ * @brief Submit the queued SQEs and wait for completions as selected by --wait.
+ *
+ * @return liburing result; a timed-out wait returns 0.
+ */
+int submit_and_wait(struct io_uring *ring, const benchmark_params &params);
+
+/**
+ * @brief Probe io_uring features, setup flags and ring fd registration on throwaway rings.
+ */
+uring_support probe_uring_support();
+
+/**
+ * @brief Print the probe result as one "io_uring:" line.
+ */
+void print_uring_support(const uring_support &support);
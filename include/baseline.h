@@ -0,0 +1,61 @@
+#pragma once
+#include "config.h"
+
+// Statistics over repeated runs (--repeat=N) and regression checks against a saved
+// baseline (--json=<file> writes one, --compare=<file> checks against it).
+//
+// Every metric is summarised over the runs that survive outlier rejection: a run whose
+// modified z-score 0.6745 * |x - median| / MAD exceeds 3.5 (Iglewicz and Hoaglin) is left
+// out of that metric. The mean gets a 95% confidence interval from Student's t.
+//
+// A comparison runs Welch's t-test per metric, because the baseline and the current runs
+// need not have the same variance or count. A metric regressed when it moved in its bad
+// direction with a two-sided p-value below 0.05, by more than its minimum change. Latency
+// percentiles come from histogram buckets, so their minimum change is one bucket width and
+// a one-bucket shift is never a verdict. Series without variance on both sides give no
+// test at all and are reported as inconclusive.
+
+struct metric_series
+{
+    std::string name;           // JSON key, e.g. "iops"
+    std::string label;          // report label, e.g. "IOPS"
+    bool higher_is_better;
+    std::vector<double> values; // one per run
+    double min_change = 0;      // relative change a verdict needs, e.g. 0.03 for 3%
+};
+
+struct series_summary
+{
+    std::vector<double> kept;   // values left after outlier rejection
+    double mean = 0;
+    double stddev = 0;          // sample standard deviation
+    double ci95 = 0;            // half width of the 95% confidence interval of the mean
+    double min = 0;
+    double max = 0;
+};
+
+/**
+ * @brief Reject outliers, then compute mean, standard deviation, 95% CI, min and max.
+ */
+series_summary summarize_series(const std::vector<double> &values);
+
+/**
+ * @brief Print one line per metric: mean, stddev, 95% CI, min, max and rejected runs.
+ */
+void print_repeat_summary(const std::vector<metric_series> &metrics, uint64_t runs);
+
+/**
+ * @brief Write the runs and their summaries, with the run configuration and kernel
+ * release, as JSON for a later --compare. Exits on failure.
+ */
+void write_baseline(const std::string &path, const benchmark_params &params, const std::vector<metric_series> &metrics);
+
+/**
+ * @brief Compare every metric with the baseline file and print the change, p-value and
+ * verdict per metric. Configuration differences are listed first. Exits when the file
+ * cannot be read.
+ *
+ * @return Number of metrics with a statistically significant regression.
+ */
+uint64_t compare_with_baseline(const std::string &path, const benchmark_params &params,
+                               const std::vector<metric_series> &metrics);
@@ -17,9 +17,11 @@
 #include <random>
 #include <string>
 #include <mutex>
+#include <atomic>
 #include <cerrno>
 #include <sys/ioctl.h>
 #include <linux/fs.h>
+#include <sys/uio.h>
 
 #include <algorithm>
 #include <numeric>
@@ -27,10 +29,36 @@
 
 #include <sstream>
 
+#include "histogram.h"
+#include "outliers.h"
+
 
 #define KIBI 1024LL
 #define KILO 1000LL
 
+struct trace_ring;
+struct trace_writer;
+struct replay_trace;
+struct compute_pipeline;
+struct shared_ring_set;
+
+// --wait: how the io_uring engines wait for completions
+enum class wait_strategy
+{
+    peek,    // never block, poll the CQ ring (liburing default)
+    block,   // block in io_uring_enter until one completion (io_uring default)
+    timeout, // block for at most wait_us, then go around the loop again
+    hybrid,  // poll for wait_us, then block
+};
+
+// --verify: checksum stamped into every written block and checked on reads
+enum class verify_algorithm
+{
+    none,
+    crc32c,
+    xxh3,
+};
+
 struct benchmark_params
 {
     std::string location;
@@ -46,34 +74,164 @@ struct benchmark_params
     uint64_t queue_depth = 1;
     uint64_t refresh_interval = 1e8; // 100ms
     std::string engine = "sync";
+    std::string trace_path;          // --trace: per-I/O binary trace file
+    std::string replay_path;         // --replay: blkparse or CSV workload to replay
+    double replay_speed = 1.0;       // --replay_speed: 1 = original timing, 0 = as fast as possible
+    std::string precondition;        // --precondition: fill steps run before the measurement
+    bool latency_breakdown = false;  // --latency_breakdown: split io_uring latency into submit/device/reap
+    uint64_t flush_interval = 0;     // --fsync/--fdatasync: flush after every N writes, 0 = never
+    bool flush_datasync = false;     // flush with fdatasync semantics instead of fsync
+    bool link_flush = false;         // --link_flush: chain each flush to its write with IOSQE_IO_LINK
+    bool odsync = false;             // --odsync: open the device with O_DSYNC
+    std::string workload = "io";     // --workload: io (fixed-size requests) or wal (append log with group commit)
+    uint64_t wal_record_size = 512;  // --wal_record_size: bytes appended per commit
+    uint64_t wal_group_size = 8;     // --wal_group_size: pending records that trigger a group flush
+    uint64_t wal_group_timeout_us = 200; // --wal_group_timeout: max wait of the oldest pending record
+    bool find_max_iops = false;      // --find-max-iops: search threads and queue depth against --slo
+    std::string slo;                 // --slo: latency target, e.g. p99:500us
+    unsigned setup_flags = 0;        // --setup_flags: IORING_SETUP_* for liburing rings
+    uint64_t cq_entries = 0;         // --cq_entries: completion queue size, 0 = kernel default (2x SQ)
+    bool register_ring_fd = false;   // --register_ring_fd: io_uring_register_ring_fd on liburing rings
+    std::string wait_spec;           // --wait as given, empty = engine default
+    wait_strategy wait = wait_strategy::peek;
+    uint64_t wait_us = 0;            // timeout or spin time for --wait=timeout/hybrid
+    uint64_t streams = 1024;         // --streams: coroutine streams per thread (coro engine)
+    uint64_t chain = 1;              // --chain: dependent I/Os per stream request (coro engine)
+    uint64_t region_offset = 0;      // --offset: first byte of the tested region
+    uint64_t region_size = 0;        // --size: bytes in the tested region, 0 = to the end of the device
+    std::string region_mode;         // --region: shared or disjoint (default: disjoint for seq, shared for rand)
+    std::vector<uint64_t> size_sweep; // --size_sweep: region sizes measured one after another
+    uint64_t rate_iops = 0;          // --rate_iops: I/Os per second over all threads, 0 = unlimited
+    std::string job_file;            // --jobs: run the jobs of this file concurrently instead
+    uint64_t first_cpu = 0;          // CPU of thread 0; jobs of a job file get consecutive CPUs
+    std::string ioprio_spec;         // --ioprio as given, empty = inherit the process priority
+    uint16_t ioprio = 0;             // IOPRIO_PRIO_VALUE(class, level); ioprio_set (sync) or sqe->ioprio
+    uint64_t outliers = 0;           // --outliers: keep the K slowest I/Os with their context, 0 = off
+    verify_algorithm verify = verify_algorithm::none; // --verify: stamp and check block contents
+    uint64_t verify_seed = 0;        // random per run, stamped into every block
+    std::string pipeline_spec;       // --pipeline: compute stage for completed reads, empty = off
+    uint64_t compute_threads = 1;    // --compute_threads: workers running the compute stage
+    bool attach_wq = false;          // --attach_wq: io_uring rings share one io-wq backend (IORING_SETUP_ATTACH_WQ)
+    uint64_t submitters = 1;         // --submitters: threads sharing one liburing ring
+    std::vector<uint64_t> thread_sweep; // --thread_sweep: thread counts measured one after another
+    uint64_t coalesce = 1;           // --coalesce: merge up to N contiguous I/Os into one readv/writev
+    uint64_t repeat = 1;             // --repeat: run the benchmark N times and report confidence intervals
+    std::string json_path;           // --json: write the --repeat runs here as a baseline
+    std::string compare_path;        // --compare: check the --repeat runs against this baseline
 
     int fd = -1;
+    bool block_device = true;        // location is a block device, not a regular file
     char *buf = nullptr;
     std::vector<uint64_t> offsets;
     uint64_t total_num_pages = 0;
     uint64_t data_size = 0;
+    trace_writer *trace = nullptr;   // set when trace_path is given
+    replay_trace *replay = nullptr;  // set when replay_path is given
+    std::atomic<uint64_t> *written_pages = nullptr; // --verify write runs: bitmap of pages written
+    compute_pipeline *pipeline = nullptr; // set when pipeline_spec is given
+    int wq_fd = -1;                  // anchor ring the --attach_wq rings attach to
+    shared_ring_set *shared_rings = nullptr; // set while submitters > 1 threads run
 
     std::ostringstream stats_buffer;
 };
 
 struct thread_stats
 {
-    uint64_t io_completed;
-    uint64_t start_time;
-    uint64_t end_time;
+    uint64_t io_completed = 0;
+    uint64_t start_time = 0;
+    uint64_t end_time = 0;
 
     std::vector<uint64_t> latencies;
+    latency_histogram latency;       // end to end, from request preparation to handled completion
+
+    // io_uring engines with --latency_breakdown
+    latency_histogram submit_delay;  // prepared -> submit syscall returned
+    latency_histogram device_time;   // submit returned -> completion visible to the thread
+    latency_histogram reap_lag;      // completion visible -> completion handled
+
+    // --fsync/--fdatasync
+    uint64_t flushes_completed = 0;
+    latency_histogram flush_latency;
+
+    // coro engine only
+    uint64_t requests_completed = 0;
+    latency_histogram request_latency; // whole chain of one stream request
+    std::vector<uint64_t> stream_requests; // requests completed per stream
+
+    // --outliers: slowest I/Os of this thread
+    outlier_heap outliers;
+
+    // --verify
+    uint64_t verify_blocks = 0;      // blocks stamped (writes) or checked (reads)
+    uint64_t verify_errors = 0;
+    uint64_t verify_ns = 0;          // thread time spent stamping and checking
+
+    // --coalesce: readv/writev requests completed, each covering one or more I/Os
+    uint64_t coalesced_requests = 0;
+
+    // replay and wal modes only
+    uint64_t bytes_completed = 0;
+    uint64_t replay_lag_sum = 0;     // ns issued behind schedule, summed over all I/Os
+    uint64_t replay_lag_max = 0;
 };
 
 uint64_t get_current_time_ns();
 
 unsigned long long get_device_size(int fd);
+unsigned int get_logical_block_size(int fd);
 std::string byte_conversion(unsigned long long bytes, const std::string &unit);
 void print_help(const char *program_name);
 benchmark_params parse_arguments(int argc, char *argv[]);
 
+// Pages of the device one thread may touch
+struct page_range
+{
+    uint64_t first; // device page index (offset / page_size)
+    uint64_t count;
+};
+
+/**
+ * @brief The whole region (--region=shared) or the thread's 1/threads partition of it (disjoint).
+ */
+page_range get_thread_pages(const benchmark_params &params, uint64_t thread_id);
+
 std::vector<uint64_t> generate_offsets(const benchmark_params &params, uint64_t thread_id);
 
+/**
+ * @brief Number of I/Os starting at offsets[first % io] that each continue the previous one
+ * on the device, at least 1 and at most limit. --coalesce merges them into one request.
+ */
+uint32_t contiguous_ios(const benchmark_params &params, const std::vector<uint64_t> &offsets, uint64_t first, uint32_t limit);
+
+/**
+ * @brief Skip bytes transferred by a short readv/writev: whole iovecs are passed over and the
+ * first one with data left is shortened in place.
+ *
+ * @return Index of the first iovec with data left (count when none is).
+ */
+uint32_t advance_iovecs(struct iovec *iov, uint32_t start, uint32_t count, uint64_t bytes);
+
+/**
+ * @brief Parse a byte count with an optional binary suffix: 4096, 512K, 1G, 2T.
+ * Throws std::invalid_argument when malformed.
+ */
+uint64_t parse_size(const std::string &text);
+
+/**
+ * @brief Parse an I/O priority: rt:<0-7>, be:<0-7>, idle or none (level defaults to 4).
+ * Throws std::invalid_argument when malformed.
+ *
+ * @return IOPRIO_PRIO_VALUE(class, level)
+ */
+uint16_t parse_ioprio(const std::string &spec);
+
+/**
+ * @brief Give the calling thread the --ioprio priority with ioprio_set (sync engine).
+ * Does nothing without --ioprio and only logs a failure; parse_arguments rejects a priority
+ * the process may not use.
+ */
+void set_thread_ioprio(const benchmark_params &params);
+
 
 uint32_t acquire_buffer(bool *is_buffer_free, uint64_t queue_depth);
 
@@ -82,4 +240,12 @@ uint64_t combine32To64(uint32_t higher, uint32_t lower);
 
 std::pair<uint32_t, uint32_t> extractBoth32(uint64_t combined);
 
-void pin_thread(uint64_t thread_id);
\ No newline at end of file
+void pin_thread(uint64_t thread_id);
+
+/**
+ * @brief With --rate_iops, the time at which a thread may start its n-th I/O
+ * (every thread gets rate_iops / threads). 0 when the rate is unlimited.
+ */
+uint64_t rate_due_time(const benchmark_params &params, uint64_t start_time, uint64_t n);
+
+trace_ring *get_trace_ring(const benchmark_params &params, uint64_t thread_id);
\ No newline at end of file
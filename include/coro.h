@@ -0,0 +1,34 @@
+#pragma once
+#include "config.h"
+#include <liburing.h>
+
+// Coroutine engine for --engine=coro.
+//
+// Each worker thread (pinned, one liburing ring per thread) runs --streams logical streams.
+// A stream is a C++20 coroutine that issues requests one after another; a request is a chain
+// of --chain dependent I/Os: the offset of every step after the first is derived from the
+// data the previous step read (read an index page, then the data page it points to); with
+// --method=seq each stream instead walks its own slice of the thread's pages. At most
+// one I/O per stream is in flight, so the ring carries up to --streams I/Os at once without
+// a thread per stream. The ring's SQ has --queue_depth entries; the CQ is sized for every
+// stream unless --cq_entries is given.
+
+/**
+ * @brief Time-based benchmark thread for the coroutine engine.
+ * io_completed and latency count individual I/Os; requests_completed and request_latency
+ * count whole chains.
+ *
+ * @param params Benchmark parameters.
+ * @param stats Thread statistics.
+ * @param thread_id Thread ID.
+ */
+void time_benchmark_thread_coro(benchmark_params &params, thread_stats &stats, uint64_t thread_id);
+
+/**
+ * @brief Print request counts, per-stream fairness and request latency over all threads.
+ *
+ * @param params Benchmark parameters.
+ * @param thread_stats_list Statistics of every worker thread.
+ * @param total_time Run time in seconds.
+ */
+void print_stream_summary(const benchmark_params &params, const std::vector<thread_stats> &thread_stats_list, double total_time);
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Log-linear latency histogram in nanoseconds (HDR style).
+//
+// Values below 2^sub_bucket_bits are counted exactly; above that, every power of two
+// is split into 2^sub_bucket_bits linear sub-buckets, so the relative error of a
+// reported percentile is below 1 / 2^sub_bucket_bits (~3%). record() is a handful of
+// integer operations and never allocates.
+
+struct latency_histogram
+{
+    static constexpr int sub_bucket_bits = 5;
+    static constexpr uint64_t sub_buckets = 1ULL << sub_bucket_bits;
+    static constexpr uint64_t num_buckets = (65 - sub_bucket_bits) * sub_buckets;
+
+    std::vector<uint64_t> counts = std::vector<uint64_t>(num_buckets, 0);
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+
+    static inline uint64_t bucket_index(uint64_t value)
+    {
+        if (value < sub_buckets)
+        {
+            return value;
+        }
+        uint64_t shift = (63 - __builtin_clzll(value)) - sub_bucket_bits;
+        return (shift + 1) * sub_buckets + ((value >> shift) & (sub_buckets - 1));
+    }
+
+    inline void record(uint64_t value)
+    {
+        counts[bucket_index(value)]++;
+        total++;
+        sum += value;
+        min = value < min ? value : min;
+        max = value > max ? value : max;
+    }
+
+    void merge(const latency_histogram &other);
+
+    /**
+     * @brief Value at the given percentile (0-100), accurate to the bucket width.
+     */
+    uint64_t percentile(double p) const;
+
+    double mean() const { return total ? double(sum) / total : 0; }
+};
+
+// Lowest value that falls into a bucket
+uint64_t histogram_bucket_floor(uint64_t index);
+
+/**
+ * @brief Print one line with count, min, mean, percentiles and max in microseconds.
+ *
+ * @param name Label, e.g. "Latency".
+ * @param h Histogram to summarise.
+ */
+void print_latency_summary(const std::string &name, const latency_histogram &h);
+
+/**
+ * @brief Print several histograms side by side with power-of-two microsecond buckets.
+ *
+ * @param names Column labels.
+ * @param histograms Histograms, one per label.
+ */
+void print_latency_histograms(const std::vector<std::string> &names, const std::vector<const latency_histogram *> &histograms);
@@ -51,8 +51,72 @@ struct io_data
 
     uint32_t buffer_id;
     uint32_t request_id;
+
+    uint8_t op;           // trace_op
+    uint64_t prep_time;   // request prepared
+    uint64_t submit_time; // submit syscall returned, only maintained with --latency_breakdown
+    uint32_t in_flight;   // requests in flight once this one was queued, for --outliers
+    int32_t result;       // res of the request's CQE, set by reap_cqes
 };
 
+/**
+ * @brief Create an io_uring instance with raw syscalls and map its SQ/CQ rings.
+ *
+ * @param s Submitter to fill in.
+ * @param queue_depth Number of SQ entries to request.
+ * @param wq_fd Ring to share the io-wq backend with (IORING_SETUP_ATTACH_WQ), -1 for none.
+ * @return 0 on success, 1 on failure (errno is printed).
+ */
+int app_setup_uring(struct submitter *s, int queue_depth, int wq_fd = -1);
+
+/**
+ * @brief Unmap the rings created by app_setup_uring and close the ring fd.
+ *
+ * @param s Submitter to tear down.
+ */
+void app_teardown_uring(struct submitter *s);
+
+/**
+ * @brief Queue one read or write SQE on the ring. The caller submits it with io_uring_enter.
+ *
+ * @param s Submitter owning the ring.
+ * @param fd Target file descriptor.
+ * @param block_size Number of bytes to transfer.
+ * @param offset Byte offset on the target.
+ * @param is_read Issue a read when true, a write otherwise.
+ * @param io Per-request data returned in the CQE user_data.
+ * @param buffer Data buffer for the request.
+ * @param buffer_id Index of the buffer, released in reap_cqes.
+ * @param request_id Request sequence number.
+ * @return The queued SQE, e.g. to set IOSQE_IO_LINK on it.
+ */
+struct io_uring_sqe *submit_io(struct submitter *s, int fd, size_t block_size, off_t offset, bool is_read, struct io_data *io, char *buffer, int buffer_id, int request_id);
+
+/**
+ * @brief Queue one fsync or fdatasync SQE. Its completion is counted in flushes_completed, not io_completed.
+ *
+ * @param s Submitter owning the ring.
+ * @param fd Target file descriptor.
+ * @param datasync Use IORING_FSYNC_DATASYNC.
+ * @param io Per-request data returned in the CQE user_data.
+ */
+void submit_flush(struct submitter *s, int fd, bool datasync, struct io_data *io);
+
+/**
+ * @brief Consume all available CQEs, releasing their buffers and recording their latency.
+ *
+ * @param s Submitter owning the ring.
+ * @param stats Statistics of the calling thread; io_completed is incremented once per CQE and
+ *              bytes_completed by the bytes each successful one transferred.
+ * @param is_buffer_free Buffer free list indexed by buffer_id.
+ * @param trace Trace ring of the calling thread, or nullptr when not tracing.
+ * @param latency_breakdown Also record submit delay, device time and reap lag.
+ * @param verify --verify algorithm: check the blocks of completed reads.
+ * @param pipeline Port of the calling thread with --pipeline: completed reads are handed to the
+ * compute stage instead of releasing their buffer.
+ */
+void reap_cqes(struct submitter *s, thread_stats &stats, bool *is_buffer_free, trace_ring *trace = nullptr, bool latency_breakdown = false,
+               verify_algorithm verify = verify_algorithm::none, struct pipeline_port *pipeline = nullptr);
 
 
 /**
@@ -74,4 +138,15 @@ void io_benchmark_thread_iou(benchmark_params &params, thread_stats &stats, uint
  * @param stats Thread statistics.
  * @param thread_id Thread ID.
  */
-void time_benchmark_thread_iou(benchmark_params &params, thread_stats &stats, uint64_t thread_id);
\ No newline at end of file
+void time_benchmark_thread_iou(benchmark_params &params, thread_stats &stats, uint64_t thread_id);
+
+
+/**
+ * @brief Replay benchmark thread for io_uring engine.
+ * Issues this thread's share of the replay trace, each request no earlier than its scheduled time.
+ * 
+ * @param params Benchmark parameters.
+ * @param stats Thread statistics.
+ * @param thread_id Thread ID.
+ */
+void replay_benchmark_thread_iou(benchmark_params &params, thread_stats &stats, uint64_t thread_id);
\ No newline at end of file
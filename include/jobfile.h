@@ -0,0 +1,63 @@
+#pragma once
+#include "config.h"
+#include <memory>
+
+// Concurrent heterogeneous jobs from an INI job file (--jobs=<file>):
+//
+//   [global]
+//   location=/dev/nvme0n1
+//   duration=30
+//
+//   [reader]
+//   engine=io_uring
+//   method=rand
+//   page_size=4096
+//
+//   [writer]
+//   method=seq
+//   type=write
+//   page_size=1048576
+//   queue_depth=8
+//   rate_iops=200
+//
+// Every [section] other than [global] is one job; keys are the long command line options
+// (boolean options are written bare or as key=true), and [global] keys apply to all jobs
+// unless a job sets them itself. Each job is parsed and validated by parse_arguments like a
+// command line of its own, so it has its own engine, pattern, queue depth, threads, rate and
+// target. All jobs are time-based and start together; their threads get consecutive CPUs.
+//
+// Priority measurement: a job with the bare key `background` is load, the others are
+// foreground. With background jobs the file runs in rounds: the foreground jobs alone,
+// then together with the background jobs, once per entry of `ioprio_sweep=<p1>,<p2>,...`
+// in [global] (the background jobs' --ioprio for that round) or once with the priorities
+// as configured. A table then compares the foreground latency percentiles of every round.
+
+struct job
+{
+    std::string name;
+    bool background = false;
+    benchmark_params params;
+    std::vector<thread_stats> stats;
+};
+
+struct job_file
+{
+    std::vector<std::unique_ptr<job>> jobs;
+    std::vector<std::string> ioprio_sweep; // background --ioprio per loaded round
+};
+
+/**
+ * @brief Parse a job file and set up every job (device opened, startup line printed).
+ * Exits with an error message on invalid files, like parse_arguments.
+ *
+ * @param path Job file path.
+ * @param skip_confirmation -y was given on the command line.
+ */
+job_file load_job_file(const std::string &path, bool skip_confirmation);
+
+/**
+ * @brief Run all jobs concurrently (in rounds when there are background jobs), printing
+ * per-job statistics every second and a per-job summary after every round, followed by
+ * the priority comparison and the totals over all rounds.
+ */
+void run_jobs(job_file &jf);
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Slowest-K I/O capture for --outliers=K: explains tail spikes on runs too long to trace.
+//
+// Every worker thread keeps a min-heap of its K slowest I/Os. Once the heap is full its
+// fastest entry is the threshold, so the hot path is one compare per I/O; only I/Os slower
+// than the threshold touch the heap. The per-thread heaps are merged to the overall K
+// slowest at the end and reported with their context and as histograms over time and LBA.
+
+struct benchmark_params;
+struct thread_stats;
+
+struct outlier_record
+{
+    uint64_t latency_ns;
+    uint64_t submit_ns;  // get_current_time_ns() when the request was prepared
+    uint64_t offset;
+    uint32_t size;
+    uint32_t in_flight;  // requests in flight on the thread right after this one was queued
+    uint16_t thread_id;
+    uint8_t op;          // trace_op
+};
+
+struct outlier_heap
+{
+    uint64_t capacity = 0;
+    uint64_t threshold = UINT64_MAX; // only I/Os slower than this are recorded; UINT64_MAX = off
+    uint16_t thread_id = 0;
+    std::vector<outlier_record> records;
+
+    /**
+     * @brief Start recording the slowest k I/Os of a thread.
+     */
+    void init(uint64_t k, uint16_t thread);
+
+    void push(const outlier_record &record);
+};
+
+/**
+ * @brief Record one completed I/O if it is among the slowest seen so far.
+ */
+inline void record_outlier(outlier_heap &heap, uint8_t op, uint64_t offset, uint32_t size,
+                           uint64_t submit_ns, uint64_t latency_ns, uint64_t in_flight)
+{
+    if (latency_ns <= heap.threshold)
+    {
+        return;
+    }
+    heap.push({latency_ns, submit_ns, offset, size, static_cast<uint32_t>(in_flight), heap.thread_id, op});
+}
+
+/**
+ * @brief Merge the threads' heaps into the overall slowest --outliers I/Os and print them
+ * with their context, followed by their distribution over run time and over the region.
+ */
+void print_outlier_report(const benchmark_params &params, const std::vector<thread_stats> &thread_stats_list);
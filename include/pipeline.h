@@ -0,0 +1,212 @@
+#pragma once
+#include "config.h"
+#include <atomic>
+#include <memory>
+
+// Read -> process pipeline for --pipeline=<stage> (liburing and io_uring read runs).
+//
+// The I/O threads do not release a buffer when its read completes. Instead they hand the
+// buffer pointer to a shared pool of --compute_threads workers through a lock-free MPMC
+// queue. A worker runs the compute stage on the buffer in place and pushes the buffer id
+// back on the owning I/O thread's return queue. The I/O thread reclaims returned buffers
+// into its free list before it queues new reads. No data is copied.
+//
+// Every thread's --queue_depth buffers are shared by its reads in flight and the buffers
+// held by the compute stage. A slow compute stage therefore throttles the reads, as it
+// would in a real reader.
+
+// Bounded lock-free multi-producer multi-consumer queue (Vyukov): one CAS per operation.
+// Every cell has a sequence number telling producers and consumers whose turn it is.
+template <typename T>
+class mpmc_queue
+{
+public:
+    explicit mpmc_queue(size_t min_capacity)
+    {
+        size_t capacity = 2;
+        while (capacity < min_capacity)
+        {
+            capacity <<= 1;
+        }
+        mask = capacity - 1;
+        cells.reset(new cell[capacity]);
+        for (size_t i = 0; i < capacity; i++)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(const T &value)
+    {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell &c = cells[pos & mask];
+            intptr_t diff = static_cast<intptr_t>(c.sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    c.data = value;
+                    c.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T &value)
+    {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell &c = cells[pos & mask];
+            intptr_t diff = static_cast<intptr_t>(c.sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = c.data;
+                    c.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<cell[]> cells;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+};
+
+enum class compute_stage
+{
+    checksum, // CRC-32C of the buffer
+    memcpy,   // copy the buffer into a worker-private one
+    spin,     // busy-wait spin_ns_per_byte for every byte
+};
+
+struct compute_pipeline;
+
+// One I/O thread's end of the pipeline. All fields except the return queue are used by the
+// I/O thread only.
+struct pipeline_port
+{
+    compute_pipeline *pipeline = nullptr;
+    uint32_t thread_id = 0;
+    std::unique_ptr<mpmc_queue<uint32_t>> returned; // buffer ids the workers are done with
+    uint64_t handed_off = 0;
+    uint64_t reclaimed = 0;
+    uint64_t held_ns = 0;      // buffers held by the compute stage, integrated over time
+    uint64_t sampled_ns = 0;   // time covered by held_ns
+    uint64_t last_sample = 0;
+
+    // Buffers of this thread currently queued for or being processed by the compute stage
+    uint64_t held() const { return handed_off - reclaimed; }
+};
+
+// A completed read waiting for, or being processed by, a compute worker
+struct pipeline_item
+{
+    pipeline_port *port;
+    char *buffer;
+    uint32_t buffer_id;
+    uint32_t length;
+    uint64_t completion_time; // read completion seen by the I/O thread
+};
+
+struct alignas(64) compute_worker_stats
+{
+    uint64_t buffers = 0;
+    uint64_t bytes = 0;
+    uint64_t busy_ns = 0;        // processing buffers
+    uint64_t start_time = 0;
+    uint64_t end_time = 0;
+    uint64_t sink = 0;           // keeps the compiler from dropping the work
+    latency_histogram queue_wait; // read completed -> worker picked the buffer up
+};
+
+struct compute_pipeline
+{
+    compute_stage stage = compute_stage::checksum;
+    double spin_ns_per_byte = 0;
+    uint64_t queue_depth = 0;     // buffers per I/O thread
+    mpmc_queue<pipeline_item> work;
+    std::vector<std::unique_ptr<pipeline_port>> ports;
+    std::vector<compute_worker_stats> workers;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping{false};
+
+    explicit compute_pipeline(size_t capacity) : work(capacity) {}
+};
+
+/**
+ * @brief Parse a --pipeline stage: checksum, memcpy or spin:<ns per byte>.
+ * Throws std::invalid_argument when malformed.
+ */
+compute_stage parse_compute_stage(const std::string &spec, double &spin_ns_per_byte);
+
+/**
+ * @brief Create one port per I/O thread and start the compute workers, pinned to the CPUs
+ * after the I/O threads.
+ */
+compute_pipeline *pipeline_start(const benchmark_params &params);
+
+/**
+ * @brief Stop the workers once the work queue is empty and join them. Call after all I/O
+ * threads returned; the pipeline is deleted by print_pipeline_summary.
+ */
+void pipeline_stop(compute_pipeline *pipeline);
+
+/**
+ * @brief The I/O thread's port, or nullptr without --pipeline.
+ */
+pipeline_port *get_pipeline_port(const benchmark_params &params, uint64_t thread_id);
+
+/**
+ * @brief Queue a completed read for the compute stage instead of freeing its buffer.
+ */
+void pipeline_hand_off(pipeline_port *port, uint32_t buffer_id, char *buffer, uint32_t length, uint64_t completion_time);
+
+/**
+ * @brief Mark the buffers the compute stage is done with as free. Call once per loop
+ * iteration; it also accounts how long the compute stage held how many buffers.
+ */
+void pipeline_reclaim(pipeline_port *port, bool *is_buffer_free, uint64_t now);
+
+/**
+ * @brief Wait until the compute stage returned every buffer of the thread, so the buffers
+ * can be freed.
+ */
+void pipeline_drain(pipeline_port *port, bool *is_buffer_free);
+
+/**
+ * @brief Print end-to-end throughput, the load of both stages and which one is the
+ * bottleneck, then free the pipeline.
+ */
+void print_pipeline_summary(compute_pipeline *pipeline, const benchmark_params &params,
+                            const std::vector<thread_stats> &thread_stats_list, double total_time);
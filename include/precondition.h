@@ -0,0 +1,36 @@
+#pragma once
+#include "config.h"
+#include <liburing.h>
+
+// Device preconditioning for --precondition=<steps>, run before the measured phase.
+//
+// Steps are comma separated and run in order:
+//  - seq-fill      write the whole device once sequentially in large blocks
+//  - rand-fill[:N] write N device capacities (default 1) at random page_size aligned offsets
+//
+// Both use io_uring at a high queue depth over several threads so they finish as fast
+// as the device allows. Their throughput is printed but never counted in the results.
+
+struct precondition_step
+{
+    std::string name;
+    bool sequential;
+    uint64_t passes;     // device capacities to write
+    uint32_t block_size; // bytes per write
+};
+
+/**
+ * @brief Parse a --precondition specification. Throws std::invalid_argument when malformed.
+ *
+ * @param spec Specification, e.g. "seq-fill,rand-fill:2".
+ * @param page_size Block size used for random fills.
+ * @return Steps in execution order.
+ */
+std::vector<precondition_step> parse_precondition(const std::string &spec, uint32_t page_size);
+
+/**
+ * @brief Run every preconditioning step against params.fd, printing progress once per second.
+ *
+ * @param params Benchmark parameters; the device must be open for writing.
+ */
+void run_precondition(const benchmark_params &params);
@@ -0,0 +1,77 @@
+#pragma once
+#include "config.h"
+
+// Workload replay for --replay=<file>.
+//
+// Accepted inputs:
+//  - blkparse text output: queue (Q) events are replayed, or issue (D) events when
+//    the trace has no Q events. Only reads and writes are kept.
+//  - CSV with columns timestamp,op,offset,size: timestamp in seconds, op R/W or
+//    read/write, offset and size in bytes. A header line selects columns by name,
+//    so io_trace2csv output (submit_ns,op,offset,size,...) can be replayed as well.
+//
+// Entries are distributed round-robin over the worker threads. Each entry is issued
+// no earlier than start_ns + timestamp / speed; speed 0 issues as fast as possible.
+
+struct replay_entry
+{
+    uint64_t timestamp_ns; // relative to the first entry
+    uint64_t offset;
+    uint32_t size;
+    uint8_t op;            // trace_op
+};
+
+struct replay_trace
+{
+    std::vector<replay_entry> entries; // sorted by timestamp
+    double speed = 1.0;                // 1 = original timing, 0 = as fast as possible
+    uint32_t max_size = 0;
+    bool has_writes = false;
+    uint64_t start_ns = 0;             // common start time of all threads, set before they launch
+};
+
+/**
+ * @brief Parse a blkparse or CSV trace. Throws std::runtime_error on malformed input.
+ *
+ * @param path Trace file.
+ * @param speed Timing factor (0 for as fast as possible).
+ * @return Loaded trace, owned by the caller.
+ */
+replay_trace *load_replay(const std::string &path, double speed);
+
+/**
+ * @brief Fold offsets onto the target region and align offsets and sizes to its logical block size.
+ *
+ * @param rt Loaded trace.
+ * @param region_offset First byte of the region (--offset).
+ * @param region_size Size of the region in bytes (--size, default the whole device).
+ * @param block_size Logical block size of the target.
+ */
+void map_replay_to_device(replay_trace *rt, uint64_t region_offset, uint64_t region_size, uint32_t block_size);
+
+/**
+ * @brief Wait until the given time, sleeping while the deadline is far and spinning close to it.
+ */
+void replay_wait_until(uint64_t deadline_ns);
+
+/**
+ * @brief Print how far the replay fell behind the original timestamps.
+ */
+void print_replay_summary(const replay_trace *rt, const std::vector<thread_stats> &thread_stats_list);
+
+// Time at which an entry is due; 0 means now (as fast as possible)
+inline uint64_t replay_deadline(const replay_trace *rt, const replay_entry &entry)
+{
+    if (rt->speed <= 0)
+    {
+        return 0;
+    }
+    return rt->start_ns + static_cast<uint64_t>(entry.timestamp_ns / rt->speed);
+}
+
+inline void replay_record_lag(thread_stats &stats, uint64_t issue_time, uint64_t deadline)
+{
+    uint64_t lag = (deadline && issue_time > deadline) ? issue_time - deadline : 0;
+    stats.replay_lag_sum += lag;
+    stats.replay_lag_max = std::max(stats.replay_lag_max, lag);
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "config.h"
+#include "pipeline.h"
+#include <liburing.h>
+
+// Ring sharing for running more threads than cores.
+//
+// --attach_wq: every io_uring ring of the run is created with IORING_SETUP_ATTACH_WQ
+// against one anchor ring, so the rings share the io-wq backend state instead of each
+// getting a private one. Since Linux 5.12 io-wq workers belong to the submitting task,
+// and the attached rings share the hashed-work map that serializes buffered writes to
+// the same file; older kernels also share the worker pool itself.
+//
+// --submitters=N (liburing): N worker threads share one ring, so there are
+// ceil(threads / N) rings and the submitters of ring g are pinned to CPU first_cpu + g.
+// A submitter prepares and submits its SQEs under the ring's spinlock and reaps every
+// CQE it finds while holding it. CQEs of other submitters go to their owner's completion
+// queue (lock-free MPSC use of mpmc_queue), so each thread still accounts only its own
+// I/Os and nothing is copied. Threads with nothing to submit only try the lock: whoever
+// holds it reaps for them. Submitters poll (--wait=peek) or sleep in io_uring_enter for at
+// most --wait=timeout:<us>; an unbounded wait could miss a completion reaped by another
+// submitter. Rings need the default setup flags: SINGLE_ISSUER and DEFER_TASKRUN forbid
+// several submitting threads, and a registered ring fd belongs to one thread.
+
+// A CQE reaped by one submitter on behalf of another
+struct shared_completion
+{
+    uint32_t buffer_id;
+    int32_t res;
+    uint64_t completion_time;
+};
+
+struct shared_ring
+{
+    struct io_uring ring;
+    std::atomic<bool> locked{false};
+    uint64_t submitters = 0;
+    std::vector<std::unique_ptr<mpmc_queue<shared_completion>>> completions; // one per submitter
+
+    // updated under the lock
+    uint64_t acquisitions = 0;        // to submit; reaping only tries the lock
+    uint64_t contended = 0;           // the lock was held when a submitter needed it
+    uint64_t reaped = 0;
+    uint64_t reaped_for_others = 0;
+};
+
+struct shared_ring_set
+{
+    std::vector<std::unique_ptr<shared_ring>> rings;
+};
+
+/**
+ * @brief Create the anchor ring that --attach_wq rings attach to and store its fd in
+ * params.wq_fd. The anchor lives until the process exits. Exits on failure.
+ */
+void open_wq_anchor(benchmark_params &params);
+
+/**
+ * @brief Create the shared rings for --submitters (params.threads / submitters rings of
+ * submitters * queue_depth entries) and store them in params.shared_rings.
+ */
+void shared_rings_start(benchmark_params &params);
+
+/**
+ * @brief Tear the shared rings down after every submitter returned.
+ */
+void shared_rings_stop(benchmark_params &params);
+
+/**
+ * @brief Time-based liburing worker that submits through the ring it shares with the
+ * other submitters of its group.
+ */
+void time_benchmark_thread_shared(benchmark_params &params, thread_stats &stats, uint64_t thread_id);
+
+/**
+ * @brief Print how often the ring locks were contended and how many completions were
+ * reaped by another submitter than their owner.
+ */
+void print_shared_ring_summary(const benchmark_params &params);
@@ -0,0 +1,116 @@
+#pragma once
+#include "config.h"
+#include <atomic>
+
+// Binary per-I/O trace written with --trace=<file>.
+//
+// File layout: one trace_file_header followed by trace_record entries. Records
+// of different threads are interleaved in flush order, not sorted by time.
+// Use io_trace2csv to convert a trace to CSV.
+
+#define TRACE_MAGIC 0x3143415254554f49ULL // "IOUTRAC1"
+#define TRACE_VERSION 1
+
+enum trace_op : uint8_t
+{
+    TRACE_OP_READ = 0,
+    TRACE_OP_WRITE = 1,
+    TRACE_OP_FLUSH = 2, // fsync or fdatasync, size 0
+    TRACE_OP_TRIM = 3,  // discard (BLKDISCARD or hole punch)
+    TRACE_OP_WRITE_ZEROES = 4, // BLKZEROOUT or zero range
+};
+
+struct trace_file_header
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t start_ns; // get_current_time_ns() when tracing started
+    uint64_t reserved;
+};
+static_assert(sizeof(trace_file_header) == 32, "trace_file_header must stay 32 bytes");
+
+// 32 bytes per I/O. Completion time is stored as a delta from submission.
+struct trace_record
+{
+    uint64_t submit_ns;
+    uint64_t offset;
+    uint32_t latency_ns; // complete_ns - submit_ns, saturated at UINT32_MAX
+    uint32_t size;
+    int32_t result;      // bytes transferred or -errno
+    uint16_t thread_id;
+    uint8_t op;          // trace_op
+    uint8_t reserved;
+};
+static_assert(sizeof(trace_record) == 32, "trace_record must stay 32 bytes");
+
+// Single-producer single-consumer ring owned by one worker thread and drained by the flusher.
+// When the flusher falls behind, records are dropped (and counted) instead of stalling the worker.
+struct trace_ring
+{
+    alignas(64) std::atomic<uint64_t> head{0}; // next record to flush, written by the flusher
+    alignas(64) std::atomic<uint64_t> tail{0}; // next free slot, written by the worker
+    uint64_t dropped = 0;                      // written by the worker
+    uint16_t thread_id = 0;
+    uint64_t mask = 0;
+    trace_record *records = nullptr;
+};
+
+struct trace_writer
+{
+    std::string path;
+    int fd = -1;
+    bool direct = false;        // file was opened with O_DIRECT
+    std::vector<trace_ring> rings;
+    std::thread flusher;
+    std::atomic<bool> running{false};
+
+    char *staging = nullptr;    // aligned block written to the file
+    uint64_t staging_used = 0;
+    uint64_t file_offset = 0;
+    uint64_t records_written = 0;
+};
+
+/**
+ * @brief Create the trace file and one ring per worker thread, and start the flusher thread.
+ *
+ * @param path Trace file path (created or truncated).
+ * @param threads Number of worker threads.
+ * @return Writer to pass to trace_close.
+ */
+trace_writer *trace_open(const std::string &path, uint64_t threads);
+
+/**
+ * @brief Stop the flusher, write out every remaining record and close the file.
+ * Prints the number of records written and dropped.
+ *
+ * @param tw Writer returned by trace_open.
+ */
+void trace_close(trace_writer *tw);
+
+/**
+ * @brief Append one record to a worker's ring. Never blocks.
+ */
+inline void trace_push(trace_ring *ring, uint8_t op, uint64_t offset, uint32_t size,
+                       uint64_t submit_ns, uint64_t complete_ns, int32_t result)
+{
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    if (tail - ring->head.load(std::memory_order_acquire) > ring->mask)
+    {
+        ring->dropped++;
+        return;
+    }
+
+    uint64_t latency = complete_ns - submit_ns;
+    trace_record &r = ring->records[tail & ring->mask];
+    r.submit_ns = submit_ns;
+    r.offset = offset;
+    r.latency_ns = latency > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(latency);
+    r.size = size;
+    r.result = result;
+    r.thread_id = ring->thread_id;
+    r.op = op;
+    r.reserved = 0;
+
+    ring->tail.store(tail + 1, std::memory_order_release);
+}
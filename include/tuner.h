@@ -0,0 +1,64 @@
+#pragma once
+#include "config.h"
+
+// Multi-step runs built from short time-based measurements (each --duration seconds):
+// the queue depth / thread count search for --find-max-iops --slo=p<percentile>:<latency>,
+// the working-set sweep for --size_sweep, the thread-count sweep for --thread_sweep, and
+// the repeated runs of --repeat.
+//
+// The search runs the normal time-based worker threads step by step. For every thread
+// count 1, 2, 4, ... up to --threads it doubles the queue depth from 1 up to --queue_depth
+// until the SLO percentile is exceeded, then bisects between the last passing and the first failing depth. Thread counts stop
+// growing once a count fails the SLO at queue depth 1 or no longer raises the best IOPS.
+//
+// Reported: every measured point, the highest IOPS that meets the SLO, and the knee of the
+// latency/throughput curve, taken as the point with the highest IOPS / latency ratio
+// (Kleinrock's power): past it, extra throughput costs proportionally more latency.
+
+struct latency_slo
+{
+    double percentile;   // e.g. 99
+    uint64_t latency_ns; // the percentile must stay at or below this
+};
+
+/**
+ * @brief Parse an --slo specification such as "p99:500us" or "p99.9:2ms".
+ * Throws std::invalid_argument when malformed.
+ */
+latency_slo parse_slo(const std::string &spec);
+
+/**
+ * @brief Run the search and print the measured points, best SLO-compliant point and knee.
+ * Ends with the usual totals block for the best point.
+ *
+ * @param params Benchmark parameters; threads and queue_depth are the upper bounds of the
+ *               search and are changed while it runs.
+ */
+void run_find_max_iops(benchmark_params &params);
+
+/**
+ * @brief Measure each --size_sweep region size in turn (starting at --offset) and print IOPS,
+ * bandwidth and latency percentiles per size, to find cache cliffs in the device.
+ *
+ * @param params Benchmark parameters; region_size is changed while it runs.
+ */
+void run_size_sweep(benchmark_params &params);
+
+/**
+ * @brief Measure each --thread_sweep thread count in turn and print IOPS, p99 latency and
+ * CPU use (cores, CPU us per I/O, IOPS per core) per count. With --attach_wq or
+ * --submitters every count is measured twice: with strict ring-per-thread and with the
+ * configured ring sharing, to show how each scales once threads outnumber cores.
+ *
+ * @param params Benchmark parameters; threads is changed while it runs.
+ */
+void run_thread_sweep(benchmark_params &params);
+
+/**
+ * @brief Run the configured benchmark --repeat times and print mean, standard deviation
+ * and 95% confidence interval of IOPS, bandwidth, latency and CPU per I/O (see baseline.h).
+ * Writes the runs to --json and checks them against --compare when set.
+ *
+ * @return true when --compare found a statistically significant regression.
+ */
+bool run_repeat(benchmark_params &params);
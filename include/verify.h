@@ -0,0 +1,103 @@
+#pragma once
+#include "config.h"
+#include <atomic>
+
+// Data-integrity mode for --verify=crc32c|xxh3.
+//
+// Write buffers are filled with random data once, when they are allocated. Before every
+// write the engine stamps the block:
+//   bytes 0..39        verify_header (magic, target offset, per-thread sequence, run seed, ...)
+//   every 512 bytes    the sequence again, so a torn write shows which sectors are old
+//   last 8 bytes       checksum of everything before it
+// Reads check the stamp of every block they complete. Write runs also record which pages
+// they wrote and read them all back in a verify pass after the measurement.
+//
+// The time spent stamping and checking is accumulated per thread and reported on its own.
+
+#define VERIFY_MAGIC 0x5946524556554f49ULL // "IOUVERFY"
+#define VERIFY_SECTOR 512
+
+struct verify_header
+{
+    uint64_t magic;
+    uint64_t offset;     // device offset the block was written for: catches misdirected writes
+    uint64_t sequence;   // per-thread write number, repeated at the start of every sector
+    uint64_t seed;       // random per run: catches stale blocks left by earlier runs
+    uint32_t block_size;
+    uint16_t algorithm;  // verify_algorithm
+    uint16_t thread_id;
+};
+static_assert(sizeof(verify_header) == 40, "verify_header must stay 40 bytes");
+
+/**
+ * @brief CRC-32C (Castagnoli), using the SSE4.2 crc32 instruction when the CPU has it.
+ */
+uint32_t crc32c(const void *data, size_t length, uint32_t crc = 0);
+
+/**
+ * @brief XXH3-64 with the default secret and seed 0, AVX2 accumulation when available.
+ * Only the long-input variant is implemented, so length must be greater than 240 bytes.
+ */
+uint64_t xxh3_64(const void *data, size_t length);
+
+/**
+ * @brief Parse a --verify algorithm name. Throws std::invalid_argument when unknown.
+ */
+verify_algorithm parse_verify(const std::string &name);
+
+/**
+ * @brief Fill a freshly allocated write buffer with random data (no-op unless verifying writes).
+ */
+void verify_prepare_buffer(const benchmark_params &params, char *buffer, uint64_t size);
+
+void verify_stamp_block(const benchmark_params &params, thread_stats &stats, char *block, uint64_t offset, uint16_t thread_id);
+void verify_check_block(verify_algorithm algorithm, thread_stats &stats, const char *block, uint32_t size, uint64_t offset);
+
+/**
+ * @brief Stamp a block right before it is written.
+ */
+inline void verify_write(const benchmark_params &params, thread_stats &stats, char *block, uint64_t offset, uint16_t thread_id)
+{
+    if (params.verify != verify_algorithm::none)
+    {
+        verify_stamp_block(params, stats, block, offset, thread_id);
+    }
+}
+
+/**
+ * @brief Check a block that was just read completely.
+ */
+inline void verify_read(verify_algorithm algorithm, thread_stats &stats, const char *block, uint32_t size, uint64_t offset)
+{
+    if (algorithm != verify_algorithm::none)
+    {
+        verify_check_block(algorithm, stats, block, size, offset);
+    }
+}
+
+/**
+ * @brief Start recording the pages a --verify write run writes, for run_verify_pass.
+ */
+void verify_track_writes(benchmark_params &params);
+
+struct verify_pass_result
+{
+    uint64_t blocks = 0;
+    uint64_t errors = 0;
+    double seconds = 0;
+};
+
+/**
+ * @brief Read back every page written during the run and check it against this run's seed.
+ * Uses params.threads threads; frees the written-page map.
+ */
+verify_pass_result run_verify_pass(benchmark_params &params);
+
+/**
+ * @brief Print blocks stamped/checked, errors and the CPU cost of verification, plus the
+ * verify pass when one ran.
+ *
+ * @return Total number of verification errors.
+ */
+uint64_t print_verify_summary(const benchmark_params &params, const std::vector<thread_stats> &thread_stats_list,
+                              const verify_pass_result &pass);
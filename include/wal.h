@@ -0,0 +1,44 @@
+#pragma once
+#include "config.h"
+
+// Append-only write-ahead log workload for --workload=wal.
+//
+// params.threads producer threads append records of wal_record_size bytes to a shared
+// in-memory log tail and block until their record is durable. One committer thread
+// coalesces pending records into a single page-aligned sequential write followed by a
+// flush (group commit): it starts a flush once wal_group_size records are pending, or
+// when the oldest pending record has waited wal_group_timeout_us. While a group is
+// being flushed, new records collect in the other half of a double buffer.
+//
+// The committer writes with the selected engine: pwrite + fdatasync (sync), or a write
+// linked to an IORING_OP_FSYNC with IOSQE_IO_LINK (io_uring, liburing). The log starts
+// at --offset and wraps at the end of the region (--size).
+
+// Committer-side results of one WAL run
+struct wal_summary
+{
+    double seconds = 0;            // wall time from the first producer start to the last flush
+    uint64_t flushes = 0;
+    uint64_t bytes_written = 0;    // including the padding to page_size
+    uint64_t records_flushed = 0;
+    uint64_t min_flush_bytes = 0;
+    uint64_t max_flush_bytes = 0;
+    latency_histogram flush_latency; // write + flush of one group
+};
+
+/**
+ * @brief Run the WAL workload for params.duration seconds.
+ * Producer i reports into thread_stats_list[i]: io_completed counts commits, latency is the
+ * commit latency seen by the producer and bytes_completed the record bytes committed.
+ *
+ * @param params Benchmark parameters.
+ * @param thread_stats_list One entry per producer thread.
+ * @return Committer statistics.
+ */
+wal_summary run_wal_workload(benchmark_params &params, std::vector<thread_stats> &thread_stats_list);
+
+/**
+ * @brief Print commits/s, flushes/s, records and bytes per flush and the group flush latency.
+ */
+void print_wal_summary(const benchmark_params &params, const wal_summary &summary,
+                       const std::vector<thread_stats> &thread_stats_list);
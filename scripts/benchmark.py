@@ -7,7 +7,7 @@ import numpy as np
 from brokenaxes import brokenaxes
 import matplotlib
 
-def run_benchmark(queue_depths, rw_types, duration, access_methods, thread_counts, engines, num_runs, csv_file, page_size):
+def run_benchmark(queue_depths, rw_types, duration, access_methods, thread_counts, engines, num_runs, csv_file, page_size, precondition=None):
     """
     Runs the io_benchmark command with different parameters and collects the results.
 
@@ -20,6 +20,8 @@ def run_benchmark(queue_depths, rw_types, duration, access_methods, thread_count
         num_runs (int): Number of times to run the benchmark for each parameter combination.
         duration (int): Duration of each benchmark run in seconds.
         csv_file (str): Path to the CSV file to store the results.
+        precondition (str): Optional --precondition steps (e.g. 'seq-fill,rand-fill:2') run before every
+            write benchmark so results reflect steady-state rather than fresh-out-of-box behaviour.
     """
     cur_dir = os.path.dirname(os.path.realpath(__file__))
     executable_location = os.path.join(cur_dir[:-7], 'build', 'io_benchmark')
@@ -72,6 +74,8 @@ def run_benchmark(queue_depths, rw_types, duration, access_methods, thread_count
                                     f'--duration={duration}',
                                     '-y'
                                 ]
+                                if precondition and rw == 'write':
+                                    cmd.append(f'--precondition={precondition}')
                                 print(f'Run {run_num+1}/{num_runs} - Running command:', ' '.join(cmd))
                                 result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
                                 output = result.stdout + result.stderr
@@ -131,6 +135,68 @@ def parse_output(output):
     return iops, bandwidth
 
 
+def run_wal_sweep(group_sizes, producer_counts, engine, duration, csv_file, record_size=512, group_timeout_us=200):
+    """
+    Runs --workload=wal for every group size and producer count and appends one row per run to csv_file.
+
+    Parameters:
+        group_sizes (list): Values for --wal_group_size.
+        producer_counts (list): Values for --threads (producer threads appending to the log).
+        engine (str): Engine used by the group committer ('sync', 'liburing' or 'io_uring').
+        duration (int): Duration of each run in seconds.
+        csv_file (str): Path to the CSV file to store the results.
+        record_size (int): Bytes per WAL record.
+        group_timeout_us (int): Longest time the oldest pending record waits for its group to fill.
+    """
+    cur_dir = os.path.dirname(os.path.realpath(__file__))
+    executable_location = os.path.join(cur_dir[:-7], 'build', 'io_benchmark')
+
+    if not os.path.exists(csv_file):
+        pd.DataFrame(columns=['engine', 'group_size', 'producers', 'commits_per_s', 'flushes_per_s',
+                              'records_per_flush', 'bytes_per_flush', 'commit_p50_us', 'commit_p99_us']).to_csv(csv_file, index=False)
+
+    for group_size in group_sizes:
+        for producers in producer_counts:
+            cmd = [
+                executable_location,
+                '--location=/dev/nvme0n1',
+                '--workload=wal',
+                f'--engine={engine}',
+                f'--threads={producers}',
+                f'--wal_group_size={group_size}',
+                f'--wal_record_size={record_size}',
+                f'--wal_group_timeout={group_timeout_us}',
+                '--time',
+                f'--duration={duration}',
+                '-y'
+            ]
+            print('Running command:', ' '.join(cmd))
+            result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+            output = result.stdout + result.stderr
+
+            commits = re.search(r'WAL Commits:\s*\d+\s*\(([\d\.eE+-]+) commits/s\)', output)
+            flushes = re.search(r'WAL Flushes:\s*\d+\s*\(([\d\.eE+-]+) flushes/s\), Records per Flush: ([\d\.eE+-]+), '
+                                r'Bytes per Flush: mean (\d+)', output)
+            latency = re.search(r'Commit Latency \(us\):.*?p50 ([\d\.]+),.*?p99 ([\d\.]+),', output)
+            if not (commits and flushes and latency):
+                print('Failed to parse output.')
+                print(output)
+                continue
+
+            pd.DataFrame({
+                'engine': [engine],
+                'group_size': [group_size],
+                'producers': [producers],
+                'commits_per_s': [float(commits.group(1))],
+                'flushes_per_s': [float(flushes.group(1))],
+                'records_per_flush': [float(flushes.group(2))],
+                'bytes_per_flush': [int(flushes.group(3))],
+                'commit_p50_us': [float(latency.group(1))],
+                'commit_p99_us': [float(latency.group(2))]
+            }).to_csv(csv_file, mode='a', header=False, index=False)
+            print(f'WAL group {group_size}, producers {producers}: {commits.group(1)} commits/s')
+
+
 def plot_threads_qd(csv_file, thread_counts, rw_types, access_methods, engines, queue_depths, duration, page_size):
     fig_size = (7, 7)
 
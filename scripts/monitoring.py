@@ -10,6 +10,7 @@ import argparse
 OUTPUT_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "monitoring_logs")
 cur_dir = os.path.dirname(os.path.realpath(__file__))
 executable_location = os.path.join(cur_dir[:-7], 'build', 'io_benchmark')
+trace2csv_location = os.path.join(cur_dir[:-7], 'build', 'io_trace2csv')
 
 # Function to run a command and log its output
 def run_command(command, log_file):
@@ -74,6 +75,37 @@ def read_benchmark_log(file_path):
     results.set_index("Elapsed Time (s)", inplace=True)
     return results
 
+def read_trace_csv(trace_file):
+    csv_file = os.path.splitext(trace_file)[0] + ".csv"
+    subprocess.run([trace2csv_location, trace_file, csv_file], check=True)
+    trace_df = pd.read_csv(csv_file)
+    trace_df["Submit Time (s)"] = trace_df["submit_ns"] / 1e9
+    trace_df["Latency (us)"] = trace_df["latency_ns"] / 1e3
+    return trace_df
+
+def plot_trace(trace_df, method, type):
+    fig, axes = plt.subplots(2, 1, figsize=(6, 6))
+
+    # Every I/O: latency over time, to locate spikes
+    axes[0].set_title("Per-I/O Latency")
+    axes[0].scatter(trace_df["Submit Time (s)"], trace_df["Latency (us)"], s=1, alpha=0.3)
+    axes[0].set_xlabel("Submit Time (s)")
+    axes[0].set_ylabel("Latency (us)")
+    axes[0].set_yscale("log")
+    axes[0].grid(True)
+
+    # Where on the device the slow I/Os went
+    axes[1].set_title("Latency by Offset")
+    axes[1].scatter(trace_df["offset"] / (1024 ** 3), trace_df["Latency (us)"], s=1, alpha=0.3, color="red")
+    axes[1].set_xlabel("Offset (GiB)")
+    axes[1].set_ylabel("Latency (us)")
+    axes[1].set_yscale("log")
+    axes[1].grid(True)
+
+    plt.tight_layout()
+    plt.savefig(os.path.join(OUTPUT_DIR, f"io_trace_{method}_{type}.svg"), transparent=True)
+    plt.close()
+
 # Plotting function
 def plot_logs(io_df, sar_df, benchmark_df, method, type):
     # Offset the DataFrame indices by 2 seconds
@@ -144,6 +176,7 @@ def main():
     parser.add_argument("--page_size", type=int, default=4096, help="Page size in bytes")
     parser.add_argument("--queue_depth", type=int, default=1, help="Queue depth")
     parser.add_argument("--duration", type=int, default=15, help="Benchmark duration in seconds")
+    parser.add_argument("--trace", action="store_true", help="Record a per-I/O trace and plot latency over time and offset")
     args = parser.parse_args()
 
     device = args.device
@@ -161,6 +194,7 @@ def main():
     iostat_log = os.path.join(OUTPUT_DIR, f"iostat_{device}.log")
     sar_log = os.path.join(OUTPUT_DIR, "sar_cpu0.log")
     benchmark_output = os.path.join(OUTPUT_DIR, "benchmark_output.log")
+    trace_file = os.path.join(OUTPUT_DIR, "benchmark_trace.bin")
 
     # Start iostat and sar
     iostat_process = run_command(["iostat", "-t", "-dx", device, "1", str(MONITOR_DURATION)], iostat_log)
@@ -183,6 +217,8 @@ def main():
         f"--queue_depth={queue_depth}",
         "-y"
     ]
+    if args.trace:
+        benchmark_cmd.append(f"--trace={trace_file}")
     print(f"Running benchmark with command: {' '.join(benchmark_cmd)}")
     with open(benchmark_output, "w") as f:
         subprocess.run(benchmark_cmd, stdout=f, stderr=subprocess.STDOUT)
@@ -204,5 +240,8 @@ def main():
     
     plot_logs(io_df, sar_df, benchmark_df, method, b_type)
 
+    if args.trace:
+        plot_trace(read_trace_csv(trace_file), method, b_type)
+
 if __name__ == "__main__":
     main()
@@ -1,8 +1,57 @@
 #include "async.h"
 #include "config.h"
+#include "trace.h"
+#include "replay.h"
+#include "verify.h"
+#include "pipeline.h"
 
+// user_data buffer id of flush requests; their request id indexes flush_prep_times
+#define FLUSH_BUFFER_ID 0xFFFFFFFFu
 
 
+int submit_and_wait(struct io_uring *ring, const benchmark_params &params)
+{
+    struct io_uring_cqe *cqe;
+
+    switch (params.wait)
+    {
+    case wait_strategy::peek:
+        return io_uring_submit(ring);
+
+    case wait_strategy::block:
+        return io_uring_submit_and_wait(ring, 1);
+
+    case wait_strategy::timeout:
+    {
+        struct __kernel_timespec ts;
+        ts.tv_sec = params.wait_us / (KILO * KILO);
+        ts.tv_nsec = (params.wait_us % (KILO * KILO)) * KILO;
+        int ret = io_uring_submit_and_wait_timeout(ring, &cqe, 1, &ts, NULL);
+        return ret == -ETIME ? 0 : ret;
+    }
+
+    case wait_strategy::hybrid:
+    {
+        int ret = io_uring_submit(ring);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        // io_uring_peek_cqe also runs deferred task work when the ring needs it
+        uint64_t spin_end = get_current_time_ns() + params.wait_us * KILO;
+        while (io_uring_peek_cqe(ring, &cqe) != 0)
+        {
+            if (get_current_time_ns() >= spin_end)
+            {
+                return io_uring_wait_cqe(ring, &cqe);
+            }
+        }
+        return ret;
+    }
+    }
+    return 0;
+}
+
 // Asynchronous I/O operation using io_uring
 void io_benchmark_thread_async(benchmark_params &params, thread_stats &stats, uint64_t thread_id)
 {
@@ -14,25 +63,39 @@ void time_benchmark_thread_async(benchmark_params &params, thread_stats &stats,
 {
 
     // pin the thread to a specific core
-    pin_thread(thread_id);
+    pin_thread(params.first_cpu + thread_id);
 
 
 
     params.io = params.duration * 1e6; // estimate number of I/O operations
     std::vector<uint64_t> offsets = generate_offsets(params, thread_id);
+    trace_ring *trace = get_trace_ring(params, thread_id);
+    uint8_t trace_op = (params.read_or_write == "write") ? TRACE_OP_WRITE : TRACE_OP_READ;
+    pipeline_port *pipeline = get_pipeline_port(params, thread_id);
 
     // Create a new io_uring instance
     struct io_uring ring;
 
     // Initialize io_uring instance
-    if (io_uring_queue_init(params.queue_depth, &ring, 0) < 0)
-    {
-        std::cerr << "Error: io_uring initialization failed\n";
-        exit(1);
-    }
+    init_liburing_ring(params, &ring, params.queue_depth);
 
     char **buffers = new char *[params.queue_depth];
     bool *is_buffer_free = new bool[params.queue_depth];
+    // per buffer: request prepared, and submit returned (only with --latency_breakdown)
+    uint64_t *prep_times = new uint64_t[params.queue_depth];
+    uint64_t *submit_times = new uint64_t[params.queue_depth];
+    std::vector<uint32_t> queued_depths(params.queue_depth); // in flight once queued, for --outliers
+    std::vector<uint32_t> batch; // buffers of the current submit, for --latency_breakdown
+    batch.reserve(params.queue_depth);
+
+    // --coalesce: a readv/writev is tracked by its first buffer, which owns a slice of
+    // coalesce iovecs and member buffer ids; short transfers resume at coalesce_done bytes
+    uint32_t coalesce = params.coalesce;
+    std::vector<struct iovec> iovecs(coalesce > 1 ? params.queue_depth * coalesce : 0);
+    std::vector<uint32_t> members(iovecs.size());
+    std::vector<uint32_t> member_count(coalesce > 1 ? params.queue_depth : 0);
+    std::vector<uint32_t> coalesce_next(member_count.size()); // first iovec with data left
+    std::vector<uint64_t> coalesce_done(member_count.size());
 
     for (int i = 0; i < params.queue_depth; i++)
     {
@@ -40,10 +103,29 @@ void time_benchmark_thread_async(benchmark_params &params, thread_stats &stats,
         {
             throw std::runtime_error("Error allocating buffer: " + std::string(strerror(errno)));
         }
+        verify_prepare_buffer(params, buffers[i], params.page_size);
         is_buffer_free[i] = true;
 
     }
 
+    // Flushes count against the queue depth, so at most queue_depth are in flight
+    std::vector<uint64_t> flush_prep_times(params.flush_interval ? params.queue_depth : 0);
+    uint64_t flushes_submitted = 0, writes_since_flush = 0;
+    bool flush_pending = false;
+    // I/Os and flushes queued or in the kernel; every final CQE decrements it, errors included
+    uint64_t in_flight = 0;
+
+    // Queue one flush; with link set it runs only after the SQE queued just before it
+    auto queue_flush = [&](uint64_t now) {
+        struct io_uring_sqe *flush = io_uring_get_sqe(&ring);
+        io_uring_prep_fsync(flush, params.fd, params.flush_datasync ? IORING_FSYNC_DATASYNC : 0);
+        uint32_t slot = flushes_submitted % flush_prep_times.size();
+        flush->user_data = combine32To64(FLUSH_BUFFER_ID, slot);
+        flush_prep_times[slot] = now;
+        flushes_submitted++;
+        in_flight++;
+    };
+
     uint32_t submitted = 0;
 
     struct io_uring_cqe *cqes[params.queue_depth];
@@ -58,8 +140,43 @@ void time_benchmark_thread_async(benchmark_params &params, thread_stats &stats,
             break;
         }
 
-        while (submitted - stats.io_completed < params.queue_depth)
+        if (pipeline)
+        {
+            pipeline_reclaim(pipeline, is_buffer_free, current_time);
+        }
+
+        while (true)
         {
+            // buffers held by the --pipeline compute stage count against the queue depth too
+            uint64_t held = in_flight + (pipeline ? pipeline->held() : 0);
+            if (held >= params.queue_depth)
+            {
+                break;
+            }
+
+            if (flush_pending)
+            {
+                // unlinked flush that did not fit next to its write
+                if (io_uring_sq_space_left(&ring) == 0)
+                {
+                    break;
+                }
+                queue_flush(current_time);
+                flush_pending = false;
+                continue;
+            }
+
+            if (rate_due_time(params, stats.start_time, submitted) > current_time)
+            {
+                break; // --rate_iops: the next I/O is not due yet
+            }
+
+            bool flush_after = params.flush_interval && writes_since_flush + 1 >= params.flush_interval;
+            if (flush_after && params.link_flush && (held + 2 > params.queue_depth || io_uring_sq_space_left(&ring) < 2))
+            {
+                break; // the write and its linked flush must be queued together
+            }
+
             struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
             if (!sqe)
             {
@@ -72,8 +189,49 @@ void time_benchmark_thread_async(benchmark_params &params, thread_stats &stats,
                 std::cerr << "Error: No free buffers available\n";  // This should never happen
             }
 
+            if (coalesce > 1)
+            {
+                // one vectored request for the next contiguous I/Os that are due and fit the queue depth
+                uint32_t count = contiguous_ios(params, offsets, submitted, std::min<uint64_t>(coalesce, params.queue_depth - held));
+                while (count > 1 && rate_due_time(params, stats.start_time, submitted + count - 1) > current_time)
+                {
+                    count--;
+                }
+                struct iovec *iov = &iovecs[buffer_id * coalesce];
+                for (uint32_t j = 0; j < count; j++)
+                {
+                    uint32_t member = j ? acquire_buffer(is_buffer_free, params.queue_depth) : buffer_id;
+                    members[buffer_id * coalesce + j] = member;
+                    iov[j] = {buffers[member], static_cast<size_t>(params.page_size)};
+                }
+                member_count[buffer_id] = count;
+                coalesce_next[buffer_id] = 0;
+                coalesce_done[buffer_id] = 0;
+                if (params.read_or_write == "write")
+                {
+                    io_uring_prep_writev(sqe, params.fd, iov, count, offsets[submitted % params.io]);
+                }
+                else
+                {
+                    io_uring_prep_readv(sqe, params.fd, iov, count, offsets[submitted % params.io]);
+                }
+                sqe->ioprio = params.ioprio;
+                sqe->user_data = combine32To64(buffer_id, submitted % params.io);
+                prep_times[buffer_id] = current_time;
+                queued_depths[buffer_id] = held + count;
+                submitted += count;
+                in_flight += count;
+                continue;
+            }
+
             if (params.read_or_write == "write")
             {
+                if (params.verify != verify_algorithm::none)
+                {
+                    // stamp outside the timed region
+                    verify_stamp_block(params, stats, buffers[buffer_id], offsets[submitted % params.io], thread_id);
+                    current_time = get_current_time_ns();
+                }
                 io_uring_prep_write(sqe, params.fd, buffers[buffer_id], params.page_size, offsets[submitted % params.io]);
             }
             else
@@ -81,21 +239,80 @@ void time_benchmark_thread_async(benchmark_params &params, thread_stats &stats,
                 io_uring_prep_read(sqe, params.fd, buffers[buffer_id], params.page_size, offsets[submitted % params.io]);
             }
 
+            sqe->ioprio = params.ioprio;
+
             // in user_data, store the buffer_id and the request_id 32bit + 32bit = 64bit aka user_data is 64bit
             sqe->user_data = combine32To64(buffer_id, submitted % params.io);
+            prep_times[buffer_id] = current_time;
+            queued_depths[buffer_id] = in_flight + 1;
+            if (params.latency_breakdown)
+            {
+                batch.push_back(buffer_id);
+            }
             submitted++;
+            in_flight++;
+
+            if (flush_after)
+            {
+                writes_since_flush = 0;
+                if (params.link_flush)
+                {
+                    io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+                    queue_flush(current_time);
+                }
+                else
+                {
+                    flush_pending = true;
+                }
+            }
+            else if (params.flush_interval)
+            {
+                writes_since_flush++;
+            }
         }
 
-        // Submit all queued requests to the kernel
-        int ret = io_uring_submit(&ring);
+        if (in_flight == 0)
+        {
+            if (pipeline && pipeline->held() > 0)
+            {
+                std::this_thread::yield(); // every buffer is with the compute stage
+                continue;
+            }
+            // rate limited with nothing in flight: sleep until the next I/O is due
+            replay_wait_until(std::min<uint64_t>(rate_due_time(params, stats.start_time, submitted),
+                                                 stats.start_time + params.duration * 1e9));
+            continue;
+        }
+
+        // Submit all queued requests to the kernel; with --latency_breakdown the submit is
+        // timed on its own before waiting
+        int ret = params.latency_breakdown ? io_uring_submit(&ring) : submit_and_wait(&ring, params);
 
                 if (ret < 0)
         {
             throw std::runtime_error("io_uring_submit failed: " + std::string(strerror(-ret)));
         }
 
+        if (params.latency_breakdown)
+        {
+            uint64_t submit_time = get_current_time_ns();
+            for (uint32_t id : batch)
+            {
+                submit_times[id] = submit_time;
+            }
+            batch.clear();
+
+            ret = submit_and_wait(&ring, params);
+            if (ret < 0)
+            {
+                throw std::runtime_error("io_uring_submit failed: " + std::string(strerror(-ret)));
+            }
+        }
+
         // Retrieve completions
         int count = io_uring_peek_batch_cqe(&ring, cqes, params.queue_depth);
+        // the CQEs became visible to this thread when the peek returned; one timestamp per batch
+        uint64_t seen_time = count > 0 ? get_current_time_ns() : 0;
 
         for (int i = 0; i < count; i++)
         {
@@ -103,11 +320,99 @@ void time_benchmark_thread_async(benchmark_params &params, thread_stats &stats,
 
             uint64_t req_id = cqe->user_data; // Retrieve original request ID
             auto [buffer_id, request_id] = extractBoth32(req_id);
+            uint64_t completion_time = params.latency_breakdown ? get_current_time_ns() : seen_time;
+
+            if (buffer_id == FLUSH_BUFFER_ID)
+            {
+                // linked flushes are cancelled when their write fails
+                if (cqe->res < 0)
+                {
+                    std::cerr << "Flush error: " << strerror(-cqe->res) << "\n";
+                }
+                stats.flush_latency.record(completion_time - flush_prep_times[request_id]);
+                stats.flushes_completed++;
+                in_flight--;
+                if (trace)
+                {
+                    trace_push(trace, TRACE_OP_FLUSH, 0, 0, flush_prep_times[request_id], completion_time, cqe->res);
+                }
+                io_uring_cqe_seen(&ring, cqe);
+                continue;
+            }
+
+            if (coalesce > 1)
+            {
+                uint32_t count = member_count[buffer_id];
+                uint64_t length = uint64_t(count) * params.page_size;
+                struct iovec *iov = &iovecs[buffer_id * coalesce];
+                if (cqe->res > 0 && coalesce_done[buffer_id] + cqe->res < length)
+                {
+                    // resubmit the rest of a short transfer from where it stopped
+                    struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+                    if (sqe)
+                    {
+                        coalesce_done[buffer_id] += cqe->res;
+                        coalesce_next[buffer_id] = advance_iovecs(iov, coalesce_next[buffer_id], count, cqe->res);
+                        uint32_t next = coalesce_next[buffer_id];
+                        uint64_t offset = offsets[request_id] + coalesce_done[buffer_id];
+                        if (params.read_or_write == "write")
+                        {
+                            io_uring_prep_writev(sqe, params.fd, iov + next, count - next, offset);
+                        }
+                        else
+                        {
+                            io_uring_prep_readv(sqe, params.fd, iov + next, count - next, offset);
+                        }
+                        sqe->ioprio = params.ioprio;
+                        sqe->user_data = req_id;
+                        io_uring_cqe_seen(&ring, cqe);
+                        continue;
+                    }
+                    std::cerr << "Failed to get SQE for resubmission\n";
+                }
+
+                // every merged I/O counts and completes with the request, like the sync engine counts failed attempts
+                bool ok = cqe->res > 0 && coalesce_done[buffer_id] + cqe->res == length;
+                if (!ok)
+                {
+                    std::cerr << "I/O error on request " << req_id << ": "
+                              << (cqe->res < 0 ? strerror(-cqe->res) : "short transfer") << "\n";
+                }
+                else
+                {
+                    stats.coalesced_requests++;
+                    for (uint32_t j = 0; j < count; j++)
+                    {
+                        stats.latency.record(completion_time - prep_times[buffer_id]);
+                    }
+                    record_outlier(stats.outliers, trace_op, offsets[request_id], length, prep_times[buffer_id],
+                                   completion_time - prep_times[buffer_id], queued_depths[buffer_id]);
+                }
+                if (trace)
+                {
+                    trace_push(trace, trace_op, offsets[request_id], length, prep_times[buffer_id], completion_time,
+                               ok ? static_cast<int32_t>(length) : cqe->res);
+                }
+                for (uint32_t j = 0; j < count; j++)
+                {
+                    is_buffer_free[members[buffer_id * coalesce + j]] = true;
+                }
+                stats.io_completed += count;
+                in_flight -= count;
+                io_uring_cqe_seen(&ring, cqe);
+                continue;
+            }
 
             if (cqe->res < 0)
             {
-                // Handle error
+                // Handle error: the I/O is not counted, but it gives its buffer and queue slot back
                 std::cerr << "I/O error on request " << req_id << ": " << strerror(-cqe->res) << "\n";
+                if (trace)
+                {
+                    trace_push(trace, trace_op, offsets[request_id], params.page_size, prep_times[buffer_id], completion_time, cqe->res);
+                }
+                is_buffer_free[buffer_id] = true;
+                in_flight--;
             }
             else if (cqe->res != params.page_size)
             {
@@ -134,18 +439,49 @@ void time_benchmark_thread_async(benchmark_params &params, thread_stats &stats,
                                            offsets[request_id] + bytes_done);
                     }
 
+                    sqe->ioprio = params.ioprio;
                     sqe->user_data = req_id; // Maintain user_data for tracking
                 }
                 else
                 {
+                    // dropped like a failed I/O
                     std::cerr << "Failed to get SQE for resubmission\n";
+                    is_buffer_free[buffer_id] = true;
+                    in_flight--;
                 }
             }
             else
             {
                 // Successful completion
-                is_buffer_free[buffer_id] = true;
                 stats.io_completed++;
+                in_flight--;
+                stats.latency.record(completion_time - prep_times[buffer_id]);
+                record_outlier(stats.outliers, trace_op, offsets[request_id], params.page_size, prep_times[buffer_id],
+                               completion_time - prep_times[buffer_id], queued_depths[buffer_id]);
+                if (params.read_or_write == "read")
+                {
+                    verify_read(params.verify, stats, buffers[buffer_id], params.page_size, offsets[request_id]);
+                }
+                if (pipeline)
+                {
+                    // the compute stage returns the buffer once it is done with it
+                    pipeline_hand_off(pipeline, buffer_id, buffers[buffer_id], params.page_size, completion_time);
+                }
+                else
+                {
+                    is_buffer_free[buffer_id] = true;
+                }
+                if (params.latency_breakdown)
+                {
+                    // a resubmitted partial I/O counts its first submission
+                    stats.submit_delay.record(submit_times[buffer_id] - prep_times[buffer_id]);
+                    stats.device_time.record(seen_time - submit_times[buffer_id]);
+                    stats.reap_lag.record(completion_time - seen_time);
+                }
+                if (trace)
+                {
+                    trace_push(trace, trace_op, offsets[request_id], params.page_size, prep_times[buffer_id], completion_time, params.page_size);
+                }
             }
 
             // Mark the CQE as seen
@@ -155,6 +491,23 @@ void time_benchmark_thread_async(benchmark_params &params, thread_stats &stats,
 
     stats.end_time = get_current_time_ns();
 
+    // Let the I/O still in flight finish without counting it: the kernel writes into the
+    // buffers until then, and --verify reads the written pages back afterwards. Nothing is
+    // resubmitted here, so every CQE is final.
+    struct io_uring_cqe *cqe;
+    io_uring_submit(&ring);
+    while (in_flight > 0 && io_uring_wait_cqe(&ring, &cqe) == 0)
+    {
+        // a --coalesce request completes all the I/Os merged into it
+        uint32_t buffer_id = extractBoth32(cqe->user_data).first;
+        in_flight -= (coalesce > 1 && buffer_id != FLUSH_BUFFER_ID) ? std::min<uint64_t>(member_count[buffer_id], in_flight) : 1;
+        io_uring_cqe_seen(&ring, cqe);
+    }
+    if (pipeline)
+    {
+        pipeline_drain(pipeline, is_buffer_free);
+    }
+
     // Free resources
 
     io_uring_queue_exit(&ring);
@@ -167,6 +520,279 @@ void time_benchmark_thread_async(benchmark_params &params, thread_stats &stats,
     
     delete[] buffers;
     delete[] is_buffer_free;
+    delete[] prep_times;
+    delete[] submit_times;
+
+
+}
+
+// Trace replay using io_uring
+void replay_benchmark_thread_async(benchmark_params &params, thread_stats &stats, uint64_t thread_id)
+{
+    pin_thread(params.first_cpu + thread_id);
+
+    replay_trace *replay = params.replay;
+    trace_ring *trace = get_trace_ring(params, thread_id);
+
+    struct io_uring ring;
+    init_liburing_ring(params, &ring, params.queue_depth);
+
+    char **buffers = new char *[params.queue_depth];
+    bool *is_buffer_free = new bool[params.queue_depth];
+    uint64_t *prep_times = new uint64_t[params.queue_depth];
+    std::vector<uint32_t> queued_depths(params.queue_depth); // in flight once queued, for --outliers
+
+    for (int i = 0; i < params.queue_depth; i++)
+    {
+        if (posix_memalign((void **)&buffers[i], params.page_size, replay->max_size) != 0)
+        {
+            throw std::runtime_error("Error allocating buffer: " + std::string(strerror(errno)));
+        }
+        is_buffer_free[i] = true;
+    }
+
+    uint64_t next = thread_id, submitted = 0;
+
+    struct io_uring_cqe *cqes[params.queue_depth];
+
+    stats.start_time = get_current_time_ns();
+
+    while (next < replay->entries.size() || submitted > stats.io_completed)
+    {
+        uint64_t current_time = get_current_time_ns();
+
+        while (next < replay->entries.size() && submitted - stats.io_completed < params.queue_depth)
+        {
+            const replay_entry &entry = replay->entries[next];
+            uint64_t deadline = replay_deadline(replay, entry);
+            if (deadline > current_time)
+            {
+                break;
+            }
+
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+            if (!sqe)
+            {
+                break;
+            }
+
+            uint32_t buffer_id = acquire_buffer(is_buffer_free, params.queue_depth);
+
+            if (entry.op == TRACE_OP_WRITE)
+            {
+                io_uring_prep_write(sqe, params.fd, buffers[buffer_id], entry.size, entry.offset);
+            }
+            else
+            {
+                io_uring_prep_read(sqe, params.fd, buffers[buffer_id], entry.size, entry.offset);
+            }
+
+            sqe->ioprio = params.ioprio;
+
+            // the request id is the index of the entry in the replay trace
+            sqe->user_data = combine32To64(buffer_id, next);
+            prep_times[buffer_id] = current_time;
+            queued_depths[buffer_id] = submitted - stats.io_completed + 1;
+            replay_record_lag(stats, current_time, deadline);
+            submitted++;
+            next += params.threads;
+        }
+
+        if (submitted == stats.io_completed)
+        {
+            // nothing in flight: sleep until the next request is due
+            replay_wait_until(replay_deadline(replay, replay->entries[next]));
+            continue;
+        }
+
+        int ret = io_uring_submit(&ring);
+        if (ret < 0)
+        {
+            throw std::runtime_error("io_uring_submit failed: " + std::string(strerror(-ret)));
+        }
+
+        int count = io_uring_peek_batch_cqe(&ring, cqes, params.queue_depth);
+        uint64_t completion_time = count > 0 ? get_current_time_ns() : 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            struct io_uring_cqe *cqe = cqes[i];
+            auto [buffer_id, request_id] = extractBoth32(cqe->user_data);
+            const replay_entry &entry = replay->entries[request_id];
+
+            if (cqe->res < 0)
+            {
+                std::cerr << "I/O error on request " << request_id << ": " << strerror(-cqe->res) << "\n";
+            }
+            else
+            {
+                if ((uint32_t)cqe->res != entry.size)
+                {
+                    std::cerr << "Partial I/O: " << cqe->res << " bytes\n";
+                }
+                stats.bytes_completed += cqe->res;
+            }
+
+            stats.latency.record(completion_time - prep_times[buffer_id]);
+            record_outlier(stats.outliers, entry.op, entry.offset, entry.size, prep_times[buffer_id],
+                           completion_time - prep_times[buffer_id], queued_depths[buffer_id]);
+            if (trace)
+            {
+                trace_push(trace, entry.op, entry.offset, entry.size, prep_times[buffer_id], completion_time, cqe->res);
+            }
+
+            is_buffer_free[buffer_id] = true;
+            stats.io_completed++;
+            io_uring_cqe_seen(&ring, cqe);
+        }
+    }
+
+    stats.end_time = get_current_time_ns();
+
+    io_uring_queue_exit(&ring);
+
+    for (int i = 0; i < params.queue_depth; i++)
+    {
+        free(buffers[i]);
+    }
+
+    delete[] buffers;
+    delete[] is_buffer_free;
+    delete[] prep_times;
+}
+
+static const std::vector<std::pair<std::string, unsigned>> setup_flag_names = {
+    {"single_issuer", IORING_SETUP_SINGLE_ISSUER},
+    {"defer_taskrun", IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_TASKRUN_FLAG},
+    {"coop_taskrun", IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG},
+};
 
+unsigned parse_setup_flags(const std::string &spec)
+{
+    unsigned flags = 0;
+    std::stringstream ss(spec);
+    std::string item;
+
+    while (std::getline(ss, item, ','))
+    {
+        auto it = std::find_if(setup_flag_names.begin(), setup_flag_names.end(),
+                               [&](const auto &entry) { return entry.first == item; });
+        if (it == setup_flag_names.end())
+        {
+            throw std::invalid_argument("unknown setup flag '" + item + "' (use single_issuer, defer_taskrun, coop_taskrun)");
+        }
+        flags |= it->second;
+    }
+    return flags;
+}
+
+void init_liburing_ring(const benchmark_params &params, struct io_uring *ring, unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = params.setup_flags;
+    if (params.cq_entries)
+    {
+        p.flags |= IORING_SETUP_CQSIZE;
+        p.cq_entries = params.cq_entries;
+    }
+    if (params.wq_fd >= 0)
+    {
+        p.flags |= IORING_SETUP_ATTACH_WQ;
+        p.wq_fd = params.wq_fd;
+    }
+
+    int ret = io_uring_queue_init_params(entries, ring, &p);
+    if (ret < 0)
+    {
+        std::cerr << "Error: io_uring initialization failed: " << strerror(-ret) << "\n";
+        exit(1);
+    }
 
-}
\ No newline at end of file
+    // lets io_uring_enter skip the fd table lookup on every call
+    if (params.register_ring_fd && io_uring_register_ring_fd(ring) != 1)
+    {
+        std::cerr << "Error: io_uring_register_ring_fd failed\n";
+        exit(1);
+    }
+}
+
+// True when a small ring can be created with `flags`
+static bool setup_flags_supported(unsigned flags)
+{
+    struct io_uring ring;
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = flags;
+    p.cq_entries = 64; // only read with IORING_SETUP_CQSIZE
+    if (io_uring_queue_init_params(4, &ring, &p) < 0)
+    {
+        return false;
+    }
+    io_uring_queue_exit(&ring);
+    return true;
+}
+
+uring_support probe_uring_support()
+{
+    uring_support support;
+
+    struct io_uring ring;
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    if (io_uring_queue_init_params(4, &ring, &p) < 0)
+    {
+        return support;
+    }
+    support.features = p.features;
+    support.register_ring_fd = io_uring_register_ring_fd(&ring) == 1;
+    io_uring_queue_exit(&ring);
+
+    // each flag on its own, together with the flags the kernel requires alongside it
+    for (unsigned flags : {IORING_SETUP_CQSIZE, IORING_SETUP_SINGLE_ISSUER, IORING_SETUP_COOP_TASKRUN,
+                           IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG,
+                           IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_SINGLE_ISSUER})
+    {
+        if (setup_flags_supported(flags))
+        {
+            support.setup_flags |= flags;
+        }
+    }
+    return support;
+}
+
+void print_uring_support(const uring_support &support)
+{
+    static const std::vector<std::pair<const char *, unsigned>> features = {
+        {"NODROP", IORING_FEAT_NODROP},
+        {"SUBMIT_STABLE", IORING_FEAT_SUBMIT_STABLE},
+        {"FAST_POLL", IORING_FEAT_FAST_POLL},
+        {"EXT_ARG", IORING_FEAT_EXT_ARG},
+        {"NATIVE_WORKERS", IORING_FEAT_NATIVE_WORKERS},
+        {"RSRC_TAGS", IORING_FEAT_RSRC_TAGS},
+        {"CQE_SKIP", IORING_FEAT_CQE_SKIP},
+        {"LINKED_FILE", IORING_FEAT_LINKED_FILE},
+    };
+    static const std::vector<std::pair<const char *, unsigned>> setup_flags = {
+        {"CQSIZE", IORING_SETUP_CQSIZE},
+        {"SINGLE_ISSUER", IORING_SETUP_SINGLE_ISSUER},
+        {"COOP_TASKRUN", IORING_SETUP_COOP_TASKRUN},
+        {"TASKRUN_FLAG", IORING_SETUP_TASKRUN_FLAG},
+        {"DEFER_TASKRUN", IORING_SETUP_DEFER_TASKRUN},
+    };
+
+    std::cout << "io_uring: Features:";
+    for (const auto &[name, bit] : features)
+    {
+        if (support.features & bit)
+        {
+            std::cout << " " << name;
+        }
+    }
+    std::cout << "\tSetup Flags:";
+    for (const auto &[name, bit] : setup_flags)
+    {
+        std::cout << " " << name << ((support.setup_flags & bit) ? "" : "(unsupported)");
+    }
+    std::cout << "\tRegistered Ring FD: " << (support.register_ring_fd ? "yes" : "no") << std::endl;
+}
@@ -0,0 +1,495 @@
+#include "baseline.h"
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sys/utsname.h>
+
+static constexpr double outlier_z = 3.5;
+static constexpr double significance = 0.05;
+
+// Regularized incomplete beta function I_x(a, b) by its continued fraction (Lentz)
+static double incomplete_beta(double a, double b, double x)
+{
+    if (x <= 0)
+    {
+        return 0;
+    }
+    if (x >= 1)
+    {
+        return 1;
+    }
+    // the continued fraction converges quickly only below the mean of the distribution
+    if (x > (a + 1) / (a + b + 2))
+    {
+        return 1 - incomplete_beta(b, a, 1 - x);
+    }
+
+    static constexpr double tiny = 1e-300;
+    double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log(1 - x)) / a;
+    double f = 1, c = 1, d = 0;
+    for (int i = 0; i <= 200; i++)
+    {
+        int m = i / 2;
+        double numerator;
+        if (i == 0)
+        {
+            numerator = 1;
+        }
+        else if (i % 2 == 0)
+        {
+            numerator = (m * (b - m) * x) / ((a + 2 * m - 1) * (a + 2 * m));
+        }
+        else
+        {
+            numerator = -((a + m) * (a + b + m) * x) / ((a + 2 * m) * (a + 2 * m + 1));
+        }
+        d = 1 + numerator * d;
+        d = std::fabs(d) < tiny ? tiny : d;
+        d = 1 / d;
+        c = 1 + numerator / c;
+        c = std::fabs(c) < tiny ? tiny : c;
+        double step = c * d;
+        f *= step;
+        if (std::fabs(1 - step) < 1e-12)
+        {
+            break;
+        }
+    }
+    return front * (f - 1);
+}
+
+// Two-sided p-value of Student's t statistic with df degrees of freedom
+static double t_test_p(double t, double df)
+{
+    return incomplete_beta(df / 2, 0.5, df / (df + t * t));
+}
+
+// t with a two-sided p-value of 0.05: 95% confidence intervals are mean +- t * s / sqrt(n)
+static double t_critical(double df)
+{
+    double low = 0, high = 1000;
+    for (int i = 0; i < 100; i++)
+    {
+        double mid = (low + high) / 2;
+        (t_test_p(mid, df) > significance ? low : high) = mid;
+    }
+    return (low + high) / 2;
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+series_summary summarize_series(const std::vector<double> &values)
+{
+    series_summary summary;
+    summary.kept = values;
+    if (values.size() >= 3)
+    {
+        double center = median(values);
+        std::vector<double> deviations;
+        for (double v : values)
+        {
+            deviations.push_back(std::fabs(v - center));
+        }
+        double mad = median(deviations);
+        if (mad > 0)
+        {
+            summary.kept.clear();
+            for (double v : values)
+            {
+                if (0.6745 * std::fabs(v - center) / mad <= outlier_z)
+                {
+                    summary.kept.push_back(v);
+                }
+            }
+        }
+    }
+
+    size_t n = summary.kept.size();
+    if (n == 0)
+    {
+        return summary;
+    }
+    summary.mean = std::accumulate(summary.kept.begin(), summary.kept.end(), 0.0) / n;
+    summary.min = *std::min_element(summary.kept.begin(), summary.kept.end());
+    summary.max = *std::max_element(summary.kept.begin(), summary.kept.end());
+    if (n > 1)
+    {
+        double squares = 0;
+        for (double v : summary.kept)
+        {
+            squares += (v - summary.mean) * (v - summary.mean);
+        }
+        summary.stddev = std::sqrt(squares / (n - 1));
+        summary.ci95 = t_critical(n - 1) * summary.stddev / std::sqrt(double(n));
+    }
+    return summary;
+}
+
+void print_repeat_summary(const std::vector<metric_series> &metrics, uint64_t runs)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << "Repeat Summary (" << runs << " runs, mean with 95% confidence interval):\n"
+        << std::setw(16) << "Metric" << std::setw(14) << "Mean" << std::setw(12) << "Stddev" << std::setw(14) << "95% CI +-"
+        << std::setw(10) << "CI %" << std::setw(14) << "Min" << std::setw(14) << "Max" << std::setw(10) << "Rejected" << "\n";
+    for (const auto &metric : metrics)
+    {
+        series_summary s = summarize_series(metric.values);
+        out << std::setw(16) << metric.label << std::setw(14) << s.mean << std::setw(12) << s.stddev
+            << std::setw(14) << s.ci95 << std::setw(10) << (s.mean ? 100 * s.ci95 / s.mean : 0)
+            << std::setw(14) << s.min << std::setw(14) << s.max
+            << std::setw(10) << metric.values.size() - s.kept.size() << "\n";
+    }
+    std::cout << out.str() << std::flush;
+}
+
+static std::string kernel_release()
+{
+    struct utsname name;
+    return uname(&name) == 0 ? name.release : "unknown";
+}
+
+// Run settings stored with a baseline; a comparison lists the ones that differ
+static std::vector<std::pair<std::string, std::string>> run_config(const benchmark_params &params)
+{
+    return {
+        {"location", params.location},
+        {"kernel", kernel_release()},
+        {"engine", params.engine},
+        {"method", params.seq_or_rand},
+        {"type", params.read_or_write},
+        {"page_size", std::to_string(params.page_size)},
+        {"threads", std::to_string(params.threads)},
+        {"queue_depth", std::to_string(params.queue_depth)},
+        {"duration", std::to_string(params.duration)},
+    };
+}
+
+static std::string json_escape(const std::string &text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+void write_baseline(const std::string &path, const benchmark_params &params, const std::vector<metric_series> &metrics)
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Error: Cannot write " << path << ": " << strerror(errno) << "\n";
+        exit(1);
+    }
+
+    file << std::setprecision(12) << "{\n  \"config\": {";
+    auto config = run_config(params);
+    for (size_t i = 0; i < config.size(); i++)
+    {
+        file << (i ? ", " : "") << "\"" << config[i].first << "\": \"" << json_escape(config[i].second) << "\"";
+    }
+    file << "},\n  \"metrics\": {\n";
+    for (size_t i = 0; i < metrics.size(); i++)
+    {
+        series_summary s = summarize_series(metrics[i].values);
+        file << "    \"" << metrics[i].name << "\": {\"higher_is_better\": " << (metrics[i].higher_is_better ? "true" : "false")
+             << ", \"mean\": " << s.mean << ", \"stddev\": " << s.stddev << ", \"ci95\": " << s.ci95 << ", \"values\": [";
+        for (size_t j = 0; j < metrics[i].values.size(); j++)
+        {
+            file << (j ? ", " : "") << metrics[i].values[j];
+        }
+        file << "]}" << (i + 1 < metrics.size() ? "," : "") << "\n";
+    }
+    file << "  }\n}\n";
+    if (!file)
+    {
+        std::cerr << "Error: Cannot write " << path << "\n";
+        exit(1);
+    }
+    std::cout << "Baseline written to " << path << std::endl;
+}
+
+// Just enough JSON for the files write_baseline produces, hand edits included
+struct json_value
+{
+    enum class kind { null, boolean, number, string, array, object } type = kind::null;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<json_value> items;
+    std::vector<std::pair<std::string, json_value>> members;
+
+    const json_value *find(const std::string &key) const
+    {
+        for (const auto &member : members)
+        {
+            if (member.first == key)
+            {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+};
+
+class json_parser
+{
+public:
+    explicit json_parser(const std::string &text) : text(text) {}
+
+    json_value parse()
+    {
+        json_value value = parse_value();
+        skip_space();
+        if (pos != text.size())
+        {
+            fail("trailing characters");
+        }
+        return value;
+    }
+
+private:
+    const std::string &text;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(const std::string &message)
+    {
+        throw std::runtime_error(message + " at byte " + std::to_string(pos));
+    }
+
+    void skip_space()
+    {
+        while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos])))
+        {
+            pos++;
+        }
+    }
+
+    void expect(char c)
+    {
+        skip_space();
+        if (pos >= text.size() || text[pos] != c)
+        {
+            fail(std::string("expected '") + c + "'");
+        }
+        pos++;
+    }
+
+    bool consume(const std::string &word)
+    {
+        if (text.compare(pos, word.size(), word) == 0)
+        {
+            pos += word.size();
+            return true;
+        }
+        return false;
+    }
+
+    std::string parse_string()
+    {
+        expect('"');
+        std::string value;
+        while (pos < text.size() && text[pos] != '"')
+        {
+            if (text[pos] == '\\' && pos + 1 < text.size())
+            {
+                pos++;
+            }
+            value += text[pos++];
+        }
+        expect('"');
+        return value;
+    }
+
+    json_value parse_value()
+    {
+        skip_space();
+        if (pos >= text.size())
+        {
+            fail("unexpected end of file");
+        }
+
+        json_value value;
+        char c = text[pos];
+        if (c == '{')
+        {
+            value.type = json_value::kind::object;
+            pos++;
+            skip_space();
+            if (pos < text.size() && text[pos] == '}')
+            {
+                pos++;
+                return value;
+            }
+            do
+            {
+                std::string key = parse_string();
+                expect(':');
+                value.members.push_back({key, parse_value()});
+                skip_space();
+            } while (pos < text.size() && text[pos] == ',' && ++pos);
+            expect('}');
+        }
+        else if (c == '[')
+        {
+            value.type = json_value::kind::array;
+            pos++;
+            skip_space();
+            if (pos < text.size() && text[pos] == ']')
+            {
+                pos++;
+                return value;
+            }
+            do
+            {
+                value.items.push_back(parse_value());
+                skip_space();
+            } while (pos < text.size() && text[pos] == ',' && ++pos);
+            expect(']');
+        }
+        else if (c == '"')
+        {
+            value.type = json_value::kind::string;
+            value.string = parse_string();
+        }
+        else if (consume("true") || consume("false"))
+        {
+            value.type = json_value::kind::boolean;
+            value.boolean = text[pos - 1] == 'e' && text[pos - 2] == 'u';
+        }
+        else if (consume("null"))
+        {
+            value.type = json_value::kind::null;
+        }
+        else
+        {
+            const char *start = text.c_str() + pos;
+            char *end = nullptr;
+            value.type = json_value::kind::number;
+            value.number = strtod(start, &end);
+            if (end == start)
+            {
+                fail("unexpected character");
+            }
+            pos += end - start;
+        }
+        return value;
+    }
+};
+
+uint64_t compare_with_baseline(const std::string &path, const benchmark_params &params,
+                               const std::vector<metric_series> &metrics)
+{
+    json_value baseline;
+    try
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error(strerror(errno));
+        }
+        std::stringstream text;
+        text << file.rdbuf();
+        baseline = json_parser(text.str()).parse();
+        if (!baseline.find("metrics"))
+        {
+            throw std::runtime_error("no \"metrics\" object");
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: Cannot read baseline " << path << ": " << e.what() << "\n";
+        exit(1);
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2) << "Compare With Baseline " << path << ":\n";
+
+    // a kernel or firmware update is the point of comparing; other differences deserve a look
+    if (const json_value *config = baseline.find("config"))
+    {
+        for (const auto &[key, current] : run_config(params))
+        {
+            const json_value *saved = config->find(key);
+            if (saved && saved->string != current)
+            {
+                out << "  config " << key << ": baseline " << saved->string << ", now " << current << "\n";
+            }
+        }
+    }
+
+    out << std::setw(16) << "Metric" << std::setw(14) << "Baseline" << std::setw(14) << "Current" << std::setw(10) << "Change"
+        << std::setw(10) << "p-value" << "  Verdict\n";
+
+    uint64_t regressions = 0;
+    const json_value &saved_metrics = *baseline.find("metrics");
+    for (const auto &metric : metrics)
+    {
+        const json_value *saved = saved_metrics.find(metric.name);
+        const json_value *saved_values = saved ? saved->find("values") : nullptr;
+        if (!saved_values || saved_values->items.size() < 2)
+        {
+            out << std::setw(16) << metric.label << "  not in the baseline (needs at least 2 runs)\n";
+            continue;
+        }
+        std::vector<double> values;
+        for (const auto &item : saved_values->items)
+        {
+            values.push_back(item.number);
+        }
+
+        series_summary before = summarize_series(values);
+        series_summary now = summarize_series(metric.values);
+        double n1 = before.kept.size(), n2 = now.kept.size();
+        double v1 = before.stddev * before.stddev / n1, v2 = now.stddev * now.stddev / n2;
+
+        // Welch's t-test; without variance on either side there is nothing to test against
+        bool testable = v1 + v2 > 0 && n1 > 1 && n2 > 1;
+        double p = 1;
+        if (testable)
+        {
+            double t = (now.mean - before.mean) / std::sqrt(v1 + v2);
+            double df = (v1 + v2) * (v1 + v2) / (v1 * v1 / (n1 - 1) + v2 * v2 / (n2 - 1));
+            p = t_test_p(t, df);
+        }
+
+        double change = before.mean ? (now.mean - before.mean) / before.mean : 0;
+        bool worse = metric.higher_is_better ? now.mean < before.mean : now.mean > before.mean;
+        const char *verdict = "no significant change";
+        if (!testable)
+        {
+            verdict = before.mean == now.mean ? "no change" : "inconclusive (no run-to-run variance)";
+        }
+        else if (p < significance && std::fabs(change) > metric.min_change)
+        {
+            verdict = worse ? "REGRESSION" : "improvement";
+            regressions += worse;
+        }
+        out << std::setw(16) << metric.label << std::setw(14) << before.mean << std::setw(14) << now.mean
+            << std::setw(9) << 100 * change << "%" << std::setw(10);
+        if (testable)
+        {
+            out << std::setprecision(4) << p << std::setprecision(2);
+        }
+        else
+        {
+            out << "-";
+        }
+        out << "  " << verdict << "\n";
+    }
+    out << (regressions ? std::to_string(regressions) + " metric(s) regressed significantly (p < 0.05)\n"
+                        : "No significant regression (p < 0.05)\n");
+    std::cout << out.str() << std::flush;
+    return regressions;
+}
@@ -1,4 +1,58 @@
 #include "config.h"
+#include "trace.h"
+#include "replay.h"
+#include "precondition.h"
+#include "tuner.h"
+#include "async.h"
+#include "verify.h"
+#include "pipeline.h"
+#include <linux/ioprio.h>
+#include <sys/syscall.h>
+#include <climits>
+
+// Options without a short form
+enum long_only_option
+{
+    OPT_TRACE = 256,
+    OPT_REPLAY,
+    OPT_REPLAY_SPEED,
+    OPT_PRECONDITION,
+    OPT_LATENCY_BREAKDOWN,
+    OPT_FSYNC,
+    OPT_FDATASYNC,
+    OPT_LINK_FLUSH,
+    OPT_ODSYNC,
+    OPT_WORKLOAD,
+    OPT_WAL_RECORD_SIZE,
+    OPT_WAL_GROUP_SIZE,
+    OPT_WAL_GROUP_TIMEOUT,
+    OPT_FIND_MAX_IOPS,
+    OPT_SLO,
+    OPT_SETUP_FLAGS,
+    OPT_CQ_ENTRIES,
+    OPT_REGISTER_RING_FD,
+    OPT_WAIT,
+    OPT_STREAMS,
+    OPT_CHAIN,
+    OPT_OFFSET,
+    OPT_SIZE,
+    OPT_REGION,
+    OPT_SIZE_SWEEP,
+    OPT_RATE_IOPS,
+    OPT_JOBS,
+    OPT_IOPRIO,
+    OPT_OUTLIERS,
+    OPT_VERIFY,
+    OPT_PIPELINE,
+    OPT_COMPUTE_THREADS,
+    OPT_ATTACH_WQ,
+    OPT_SUBMITTERS,
+    OPT_THREAD_SWEEP,
+    OPT_COALESCE,
+    OPT_REPEAT,
+    OPT_JSON,
+    OPT_COMPARE,
+};
 
 uint64_t get_current_time_ns() {
 
@@ -9,6 +63,10 @@ uint64_t get_current_time_ns() {
 }
 
 unsigned long long get_device_size(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        return st.st_size;
+    }
     unsigned long long size;
     if (ioctl(fd, BLKGETSIZE64, &size) == -1) {
         throw std::runtime_error("Failed to get device size using ioctl: " + std::string(strerror(errno)));
@@ -16,6 +74,14 @@ unsigned long long get_device_size(int fd) {
     return size;
 }
 
+unsigned int get_logical_block_size(int fd) {
+    int size;
+    if (ioctl(fd, BLKSSZGET, &size) == -1) {
+        throw std::runtime_error("Failed to get logical block size using ioctl: " + std::string(strerror(errno)));
+    }
+    return size;
+}
+
 benchmark_params parse_arguments(int argc, char *argv[]) {
     benchmark_params params;
 
@@ -33,13 +99,55 @@ benchmark_params parse_arguments(int argc, char *argv[]) {
         {"sync", no_argument, nullptr, 's'},
         {"async", no_argument, nullptr, 'a'},
         {"skip_confirmation", no_argument, nullptr, 'y'},
+        {"trace", required_argument, nullptr, OPT_TRACE},
+        {"replay", required_argument, nullptr, OPT_REPLAY},
+        {"replay_speed", required_argument, nullptr, OPT_REPLAY_SPEED},
+        {"precondition", required_argument, nullptr, OPT_PRECONDITION},
+        {"latency_breakdown", no_argument, nullptr, OPT_LATENCY_BREAKDOWN},
+        {"fsync", required_argument, nullptr, OPT_FSYNC},
+        {"fdatasync", required_argument, nullptr, OPT_FDATASYNC},
+        {"link_flush", no_argument, nullptr, OPT_LINK_FLUSH},
+        {"odsync", no_argument, nullptr, OPT_ODSYNC},
+        {"workload", required_argument, nullptr, OPT_WORKLOAD},
+        {"wal_record_size", required_argument, nullptr, OPT_WAL_RECORD_SIZE},
+        {"wal_group_size", required_argument, nullptr, OPT_WAL_GROUP_SIZE},
+        {"wal_group_timeout", required_argument, nullptr, OPT_WAL_GROUP_TIMEOUT},
+        {"find-max-iops", no_argument, nullptr, OPT_FIND_MAX_IOPS},
+        {"slo", required_argument, nullptr, OPT_SLO},
+        {"setup_flags", required_argument, nullptr, OPT_SETUP_FLAGS},
+        {"cq_entries", required_argument, nullptr, OPT_CQ_ENTRIES},
+        {"register_ring_fd", no_argument, nullptr, OPT_REGISTER_RING_FD},
+        {"wait", required_argument, nullptr, OPT_WAIT},
+        {"streams", required_argument, nullptr, OPT_STREAMS},
+        {"chain", required_argument, nullptr, OPT_CHAIN},
+        {"offset", required_argument, nullptr, OPT_OFFSET},
+        {"size", required_argument, nullptr, OPT_SIZE},
+        {"region", required_argument, nullptr, OPT_REGION},
+        {"size_sweep", required_argument, nullptr, OPT_SIZE_SWEEP},
+        {"rate_iops", required_argument, nullptr, OPT_RATE_IOPS},
+        {"jobs", required_argument, nullptr, OPT_JOBS},
+        {"ioprio", required_argument, nullptr, OPT_IOPRIO},
+        {"outliers", required_argument, nullptr, OPT_OUTLIERS},
+        {"verify", required_argument, nullptr, OPT_VERIFY},
+        {"pipeline", required_argument, nullptr, OPT_PIPELINE},
+        {"compute_threads", required_argument, nullptr, OPT_COMPUTE_THREADS},
+        {"attach_wq", no_argument, nullptr, OPT_ATTACH_WQ},
+        {"submitters", required_argument, nullptr, OPT_SUBMITTERS},
+        {"thread_sweep", required_argument, nullptr, OPT_THREAD_SWEEP},
+        {"coalesce", required_argument, nullptr, OPT_COALESCE},
+        {"repeat", required_argument, nullptr, OPT_REPEAT},
+        {"json", required_argument, nullptr, OPT_JSON},
+        {"compare", required_argument, nullptr, OPT_COMPARE},
         {"help", no_argument, nullptr, 'h'},
         {nullptr, 0, nullptr, 0}
     };
 
     int opt;
     bool sync_flag_set, async_flag_set;
+    std::string setup_flags_spec;
+    int options_given = 0;
     while ((opt = getopt_long(argc, argv, "l:p:m:t:i:T:d:n:q:e:yh", long_options, nullptr)) != -1) {
+        options_given++;
         switch (opt) {
             case 'l': params.location = optarg; break;
             case 'p': params.page_size = std::stoi(optarg); break;
@@ -52,6 +160,113 @@ benchmark_params parse_arguments(int argc, char *argv[]) {
             case 'q': params.queue_depth = std::stoull(optarg); break;
             case 'e': params.engine = optarg; break;
             case 'y': params.skip_confirmation = true; break;
+            case OPT_TRACE: params.trace_path = optarg; break;
+            case OPT_REPLAY: params.replay_path = optarg; break;
+            case OPT_REPLAY_SPEED:
+                params.replay_speed = (std::string(optarg) == "afap") ? 0 : std::stod(optarg);
+                break;
+            case OPT_PRECONDITION: params.precondition = optarg; break;
+            case OPT_LATENCY_BREAKDOWN: params.latency_breakdown = true; break;
+            case OPT_FSYNC:
+            case OPT_FDATASYNC:
+                if (params.flush_interval) {
+                    std::cerr << "Error: --fsync and --fdatasync are mutually exclusive.\n";
+                    exit(1);
+                }
+                params.flush_interval = std::stoull(optarg);
+                params.flush_datasync = (opt == OPT_FDATASYNC);
+                if (params.flush_interval == 0) {
+                    std::cerr << "Error: Invalid flush interval.\n";
+                    exit(1);
+                }
+                break;
+            case OPT_LINK_FLUSH: params.link_flush = true; break;
+            case OPT_ODSYNC: params.odsync = true; break;
+            case OPT_WORKLOAD: params.workload = optarg; break;
+            case OPT_WAL_RECORD_SIZE: params.wal_record_size = std::stoull(optarg); break;
+            case OPT_WAL_GROUP_SIZE: params.wal_group_size = std::stoull(optarg); break;
+            case OPT_WAL_GROUP_TIMEOUT: params.wal_group_timeout_us = std::stoull(optarg); break;
+            case OPT_FIND_MAX_IOPS: params.find_max_iops = true; break;
+            case OPT_SLO: params.slo = optarg; break;
+            case OPT_SETUP_FLAGS:
+                setup_flags_spec = optarg;
+                try {
+                    params.setup_flags = parse_setup_flags(optarg);
+                } catch (const std::exception &e) {
+                    std::cerr << "Error: Invalid --setup_flags: " << e.what() << "\n";
+                    exit(1);
+                }
+                break;
+            case OPT_CQ_ENTRIES: params.cq_entries = std::stoull(optarg); break;
+            case OPT_REGISTER_RING_FD: params.register_ring_fd = true; break;
+            case OPT_WAIT: params.wait_spec = optarg; break;
+            case OPT_STREAMS: params.streams = std::stoull(optarg); break;
+            case OPT_CHAIN: params.chain = std::stoull(optarg); break;
+            case OPT_OFFSET:
+            case OPT_SIZE:
+            case OPT_SIZE_SWEEP:
+                try {
+                    if (opt == OPT_SIZE_SWEEP) {
+                        std::stringstream ss(optarg);
+                        std::string item;
+                        while (std::getline(ss, item, ',')) {
+                            params.size_sweep.push_back(parse_size(item));
+                        }
+                    } else {
+                        (opt == OPT_OFFSET ? params.region_offset : params.region_size) = parse_size(optarg);
+                    }
+                } catch (const std::exception &e) {
+                    std::cerr << "Error: Invalid size '" << optarg << "': " << e.what() << "\n";
+                    exit(1);
+                }
+                break;
+            case OPT_REGION: params.region_mode = optarg; break;
+            case OPT_RATE_IOPS: params.rate_iops = std::stoull(optarg); break;
+            case OPT_JOBS: params.job_file = optarg; break;
+            case OPT_OUTLIERS: params.outliers = std::stoull(optarg); break;
+            case OPT_IOPRIO:
+                params.ioprio_spec = optarg;
+                try {
+                    params.ioprio = parse_ioprio(optarg);
+                } catch (const std::exception &e) {
+                    std::cerr << "Error: Invalid --ioprio: " << e.what() << "\n";
+                    exit(1);
+                }
+                break;
+            case OPT_VERIFY:
+                try {
+                    params.verify = parse_verify(optarg);
+                } catch (const std::exception &e) {
+                    std::cerr << "Error: Invalid --verify: " << e.what() << "\n";
+                    exit(1);
+                }
+                params.verify_seed = std::random_device{}() | (uint64_t(std::random_device{}()) << 32) | 1;
+                break;
+            case OPT_PIPELINE:
+                params.pipeline_spec = optarg;
+                try {
+                    double spin_ns_per_byte;
+                    parse_compute_stage(optarg, spin_ns_per_byte);
+                } catch (const std::exception &e) {
+                    std::cerr << "Error: Invalid --pipeline: " << e.what() << "\n";
+                    exit(1);
+                }
+                break;
+            case OPT_COMPUTE_THREADS: params.compute_threads = std::stoull(optarg); break;
+            case OPT_ATTACH_WQ: params.attach_wq = true; break;
+            case OPT_SUBMITTERS: params.submitters = std::stoull(optarg); break;
+            case OPT_COALESCE: params.coalesce = std::stoull(optarg); break;
+            case OPT_REPEAT: params.repeat = std::stoull(optarg); break;
+            case OPT_JSON: params.json_path = optarg; break;
+            case OPT_COMPARE: params.compare_path = optarg; break;
+            case OPT_THREAD_SWEEP: {
+                std::stringstream ss(optarg);
+                std::string item;
+                while (std::getline(ss, item, ',')) {
+                    params.thread_sweep.push_back(std::stoull(item));
+                }
+                break;
+            }
             case 'h': print_help(argv[0]); exit(0);
             default: 
                 std::cerr << "Invalid option. Use --help for usage information.\n"; 
@@ -59,6 +274,15 @@ benchmark_params parse_arguments(int argc, char *argv[]) {
         }
     }
 
+    // every job of a job file goes through parse_arguments on its own (see jobfile.h)
+    if (!params.job_file.empty()) {
+        if (options_given > 1 + params.skip_confirmation) {
+            std::cerr << "Error: --jobs takes every setting from the job file (only -y may be added).\n";
+            exit(1);
+        }
+        return params;
+    }
+
     // Validate time-based parameters
     if (params.time_based) {
         if (params.duration == 0) {
@@ -104,7 +328,7 @@ benchmark_params parse_arguments(int argc, char *argv[]) {
     }
 
 
-    if (params.engine != "sync" && params.engine != "liburing" && params.engine != "io_uring") {
+    if (params.engine != "sync" && params.engine != "liburing" && params.engine != "io_uring" && params.engine != "coro") {
         std::cerr << "Error: Invalid engine.\n";
         exit(1);
     }
@@ -114,15 +338,329 @@ benchmark_params parse_arguments(int argc, char *argv[]) {
         exit(1);
     }
 
-    if (params.read_or_write != "read" && params.read_or_write != "write") {
+    if (params.read_or_write != "read" && params.read_or_write != "write" && params.read_or_write != "trim" &&
+        params.read_or_write != "write_zeroes") {
         std::cerr << "Error: Invalid operation type.\n";
         exit(1);
     }
 
+    // range operations carry no data: there is nothing to flush, verify or process
+    if ((params.read_or_write == "trim" || params.read_or_write == "write_zeroes") &&
+        (params.engine != "sync" || params.workload != "io" || !params.replay_path.empty() ||
+         params.verify != verify_algorithm::none || !params.pipeline_spec.empty())) {
+        std::cerr << "Error: --type=trim and --type=write_zeroes need the sync engine and plain read/write workloads "
+                  << "(no --workload=wal, --replay, --verify or --pipeline).\n";
+        exit(1);
+    }
+
+    if (params.latency_breakdown && (params.engine == "sync" || !params.time_based)) {
+        std::cerr << "Error: --latency_breakdown needs a time-based run with the io_uring or liburing engine.\n";
+        exit(1);
+    }
+
+    if (params.flush_interval && params.read_or_write != "write") {
+        std::cerr << "Error: --fsync/--fdatasync need --type=write.\n";
+        exit(1);
+    }
+
+    if (params.link_flush && (!params.flush_interval || params.engine == "sync")) {
+        std::cerr << "Error: --link_flush needs --fsync or --fdatasync with the io_uring or liburing engine.\n";
+        exit(1);
+    }
+
+    if (params.link_flush && params.queue_depth < 2) {
+        std::cerr << "Error: --link_flush needs a queue depth of at least 2.\n";
+        exit(1);
+    }
+
+    if (params.replay_speed < 0) {
+        std::cerr << "Error: Invalid replay speed.\n";
+        exit(1);
+    }
+
+    if ((params.setup_flags || params.cq_entries || params.register_ring_fd) &&
+        params.engine != "liburing" && params.engine != "coro") {
+        std::cerr << "Error: --setup_flags, --cq_entries and --register_ring_fd need --engine=liburing or coro.\n";
+        exit(1);
+    }
+
+    if (params.engine == "coro") {
+        if (!params.time_based || !params.replay_path.empty() || params.workload != "io" || params.find_max_iops ||
+            params.flush_interval || params.latency_breakdown) {
+            std::cerr << "Error: --engine=coro supports plain time-based read/write runs only.\n";
+            exit(1);
+        }
+        if (params.streams == 0 || params.chain == 0) {
+            std::cerr << "Error: --streams and --chain must be at least 1.\n";
+            exit(1);
+        }
+        // every stream can have one completion outstanding; the kernel caps the CQ at 64Ki entries
+        if (params.cq_entries == 0) {
+            params.cq_entries = std::min<uint64_t>(std::max(params.streams, params.queue_depth), 65536);
+        }
+    }
+
+    if (params.rate_iops && (!params.time_based || params.engine == "coro" || params.workload != "io" ||
+                             params.find_max_iops || !params.size_sweep.empty() || !params.thread_sweep.empty())) {
+        std::cerr << "Error: --rate_iops needs a plain time-based run with the sync, liburing or io_uring engine.\n";
+        exit(1);
+    }
+
+    // Try the priority here, where a refusal (rt without CAP_SYS_NICE) is a usage error; the
+    // workers set it again and only log. The main thread keeps its own priority, since the
+    // jobs of a job file share it.
+    if (!params.ioprio_spec.empty()) {
+        int previous = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, params.ioprio) < 0) {
+            int err = errno;
+            std::cerr << "Error: Cannot set --ioprio=" << params.ioprio_spec << ": " << strerror(err)
+                      << (err == EPERM ? " (the rt class needs CAP_SYS_NICE or CAP_SYS_ADMIN)" : "") << "\n";
+            exit(1);
+        }
+        if (previous >= 0) {
+            syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, previous);
+        }
+    }
+
+    if (params.outliers && (params.workload != "io" || params.find_max_iops || !params.size_sweep.empty() ||
+                            !params.thread_sweep.empty())) {
+        std::cerr << "Error: --outliers cannot be combined with --workload=wal, --find-max-iops, --size_sweep or --thread_sweep.\n";
+        exit(1);
+    }
+
+    if (params.verify != verify_algorithm::none) {
+        if (params.workload != "io" || !params.replay_path.empty() || params.find_max_iops || !params.size_sweep.empty() ||
+            !params.thread_sweep.empty()) {
+            std::cerr << "Error: --verify cannot be combined with --workload=wal, --replay, --find-max-iops, --size_sweep or --thread_sweep.\n";
+            exit(1);
+        }
+        if (params.page_size < VERIFY_SECTOR || params.page_size % VERIFY_SECTOR) {
+            std::cerr << "Error: --verify needs a page size that is a multiple of " << VERIFY_SECTOR << " bytes.\n";
+            exit(1);
+        }
+    }
+
+    if (!params.pipeline_spec.empty()) {
+        if ((params.engine != "liburing" && params.engine != "io_uring") || !params.time_based ||
+            params.read_or_write != "read" || params.workload != "io" || !params.replay_path.empty() ||
+            params.find_max_iops || !params.size_sweep.empty() || !params.thread_sweep.empty()) {
+            std::cerr << "Error: --pipeline needs a plain time-based read run with the liburing or io_uring engine.\n";
+            exit(1);
+        }
+        if (params.compute_threads == 0) {
+            std::cerr << "Error: --compute_threads must be at least 1.\n";
+            exit(1);
+        }
+    }
+
+    if (params.cq_entries && params.cq_entries < params.queue_depth) {
+        std::cerr << "Error: --cq_entries must be at least the queue depth.\n";
+        exit(1);
+    }
+
+    // the engines' historical behaviour is the default: liburing polls, io_uring (and coro) block
+    if (params.wait_spec.empty()) {
+        params.wait = (params.engine == "liburing") ? wait_strategy::peek : wait_strategy::block;
+    } else {
+        if (params.engine == "sync") {
+            std::cerr << "Error: --wait needs the io_uring or liburing engine.\n";
+            exit(1);
+        }
+        std::string mode = params.wait_spec.substr(0, params.wait_spec.find(':'));
+        bool has_value = params.wait_spec.find(':') != std::string::npos;
+        if (mode == "peek" && !has_value) {
+            params.wait = wait_strategy::peek;
+        } else if (mode == "block" && !has_value) {
+            params.wait = wait_strategy::block;
+        } else if ((mode == "timeout" || mode == "hybrid") && has_value) {
+            params.wait = (mode == "timeout") ? wait_strategy::timeout : wait_strategy::hybrid;
+            params.wait_us = std::stoull(params.wait_spec.substr(params.wait_spec.find(':') + 1));
+        } else {
+            std::cerr << "Error: Invalid --wait (use peek, block, timeout:<us> or hybrid:<spin_us>).\n";
+            exit(1);
+        }
+        if (params.wait == wait_strategy::timeout && params.wait_us == 0) {
+            std::cerr << "Error: --wait=timeout needs a non-zero timeout.\n";
+            exit(1);
+        }
+    }
+
+    if (params.attach_wq && params.engine == "sync") {
+        std::cerr << "Error: --attach_wq needs an io_uring engine (liburing, io_uring or coro).\n";
+        exit(1);
+    }
+
+    if (params.submitters == 0) {
+        std::cerr << "Error: --submitters must be at least 1.\n";
+        exit(1);
+    }
+    if (params.submitters > 1) {
+        if (params.engine != "liburing" || !params.time_based || params.workload != "io" || !params.replay_path.empty() ||
+            (params.read_or_write != "read" && params.read_or_write != "write") || params.flush_interval ||
+            params.latency_breakdown || params.verify != verify_algorithm::none || !params.pipeline_spec.empty()) {
+            std::cerr << "Error: --submitters needs a plain time-based read or write run with the liburing engine "
+                      << "(no --fsync, --latency_breakdown, --verify or --pipeline).\n";
+            exit(1);
+        }
+        // several threads enter one ring: it must not be tied to a single issuer
+        if (params.setup_flags || params.register_ring_fd) {
+            std::cerr << "Error: --submitters cannot be combined with --setup_flags or --register_ring_fd.\n";
+            exit(1);
+        }
+        if (params.wait != wait_strategy::peek && params.wait != wait_strategy::timeout) {
+            std::cerr << "Error: --submitters supports --wait=peek or --wait=timeout:<us> only.\n";
+            exit(1);
+        }
+    }
+
+    if (params.coalesce == 0 || params.coalesce > IOV_MAX) {
+        std::cerr << "Error: --coalesce must be between 1 and " << IOV_MAX << ".\n";
+        exit(1);
+    }
+    if (params.coalesce > 1) {
+        if (params.seq_or_rand != "seq" || !params.time_based || params.workload != "io" || !params.replay_path.empty() ||
+            (params.engine != "sync" && params.engine != "liburing") ||
+            (params.read_or_write != "read" && params.read_or_write != "write")) {
+            std::cerr << "Error: --coalesce needs a time-based --method=seq read or write run with the sync or liburing engine.\n";
+            exit(1);
+        }
+        if (params.flush_interval || params.latency_breakdown || params.verify != verify_algorithm::none ||
+            !params.pipeline_spec.empty() || params.submitters > 1) {
+            std::cerr << "Error: --coalesce cannot be combined with --fsync, --latency_breakdown, --verify, --pipeline or --submitters.\n";
+            exit(1);
+        }
+    }
+
+    if (!params.thread_sweep.empty()) {
+        if (!params.time_based || params.workload != "io" || !params.replay_path.empty() || params.find_max_iops ||
+            !params.size_sweep.empty()) {
+            std::cerr << "Error: --thread_sweep needs a plain time-based run (--duration is the time per step).\n";
+            exit(1);
+        }
+        if (std::find(params.thread_sweep.begin(), params.thread_sweep.end(), 0) != params.thread_sweep.end()) {
+            std::cerr << "Error: --thread_sweep thread counts must be at least 1.\n";
+            exit(1);
+        }
+        // sized for the largest step, e.g. the disjoint partitions and the startup line
+        params.threads = *std::max_element(params.thread_sweep.begin(), params.thread_sweep.end());
+    }
+
+    if (params.repeat == 0) {
+        std::cerr << "Error: --repeat must be at least 1.\n";
+        exit(1);
+    }
+    if (params.repeat > 1) {
+        if (!params.time_based || params.workload != "io" || !params.replay_path.empty() || params.find_max_iops ||
+            !params.size_sweep.empty() || !params.thread_sweep.empty()) {
+            std::cerr << "Error: --repeat needs a plain time-based run (--duration is the time per run).\n";
+            exit(1);
+        }
+        if (!params.trace_path.empty() || params.outliers || params.verify != verify_algorithm::none ||
+            !params.pipeline_spec.empty()) {
+            std::cerr << "Error: --repeat cannot be combined with --trace, --outliers, --verify or --pipeline.\n";
+            exit(1);
+        }
+    }
+    // a confidence interval and a t-test need at least two runs
+    if ((!params.json_path.empty() || !params.compare_path.empty()) && params.repeat < 2) {
+        std::cerr << "Error: --json and --compare need --repeat of at least 2.\n";
+        exit(1);
+    }
+
+    if (!params.region_mode.empty() && params.region_mode != "shared" && params.region_mode != "disjoint") {
+        std::cerr << "Error: Invalid region (use shared or disjoint).\n";
+        exit(1);
+    }
+    if (params.region_mode.empty()) {
+        params.region_mode = (params.seq_or_rand == "seq") ? "disjoint" : "shared";
+    }
+
+    if (!params.size_sweep.empty()) {
+        if (!params.time_based || params.workload != "io" || !params.replay_path.empty() || params.find_max_iops) {
+            std::cerr << "Error: --size_sweep needs a plain time-based run (--duration is the time per size).\n";
+            exit(1);
+        }
+        if (params.region_size) {
+            std::cerr << "Error: --size and --size_sweep are mutually exclusive.\n";
+            exit(1);
+        }
+    }
+
+    if (params.workload != "io" && params.workload != "wal") {
+        std::cerr << "Error: Invalid workload.\n";
+        exit(1);
+    }
+
+    if (params.workload == "wal") {
+        if (!params.time_based) {
+            std::cerr << "Error: --workload=wal needs --time and --duration.\n";
+            exit(1);
+        }
+        if (!params.replay_path.empty() || !params.trace_path.empty() || params.flush_interval ||
+            params.latency_breakdown) {
+            std::cerr << "Error: --workload=wal cannot be combined with --replay, --trace, --fsync/--fdatasync "
+                         "or --latency_breakdown.\n";
+            exit(1);
+        }
+        // 16 bytes hold the record header (lsn, producer, length); 4 MiB is one log buffer
+        if (params.wal_record_size < 16 || params.wal_record_size > 4 * KIBI * KIBI) {
+            std::cerr << "Error: Invalid WAL record size.\n";
+            exit(1);
+        }
+        if (params.wal_group_size == 0) {
+            std::cerr << "Error: Invalid WAL group size.\n";
+            exit(1);
+        }
+    }
+
+    if (params.find_max_iops) {
+        if (!params.time_based || params.slo.empty()) {
+            std::cerr << "Error: --find-max-iops needs --slo and --time with --duration (seconds per step).\n";
+            exit(1);
+        }
+        if (!params.replay_path.empty() || !params.trace_path.empty() || params.workload != "io") {
+            std::cerr << "Error: --find-max-iops cannot be combined with --replay, --trace or --workload=wal.\n";
+            exit(1);
+        }
+        try {
+            parse_slo(params.slo);
+        } catch (const std::exception &e) {
+            std::cerr << "Error: Invalid --slo: " << e.what() << "\n";
+            exit(1);
+        }
+    } else if (!params.slo.empty()) {
+        std::cerr << "Error: --slo requires --find-max-iops.\n";
+        exit(1);
+    }
+
+    if (!params.replay_path.empty()) {
+        if (params.time_based) {
+            std::cerr << "Error: --replay cannot be combined with --time.\n";
+            exit(1);
+        }
+        try {
+            params.replay = load_replay(params.replay_path, params.replay_speed);
+        } catch (const std::exception &e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            exit(1);
+        }
+    }
+
+    if (!params.precondition.empty()) {
+        try {
+            parse_precondition(params.precondition, params.page_size);
+        } catch (const std::exception &e) {
+            std::cerr << "Error: Invalid --precondition: " << e.what() << "\n";
+            exit(1);
+        }
+    }
+
+    bool writes = params.read_or_write != "read" || (params.replay && params.replay->has_writes) ||
+                  !params.precondition.empty() || params.workload == "wal";
 
     // if write add flag O_SYNC to ensure data is written to disk
-    if (params.read_or_write == "write") {
-        params.fd = open(params.location.c_str(), O_RDWR | O_DIRECT);
+    if (writes) {
+        params.fd = open(params.location.c_str(), O_RDWR | O_DIRECT | (params.odsync ? O_DSYNC : 0));
     } else {
         params.fd = open(params.location.c_str(), O_RDONLY | O_DIRECT);
     }
@@ -134,9 +672,48 @@ benchmark_params parse_arguments(int argc, char *argv[]) {
     }
 
     params.device_size = get_device_size(params.fd);
+    struct stat st;
+    params.block_device = fstat(params.fd, &st) != 0 || S_ISBLK(st.st_mode);
+
+    // Region checks need the device size
+    uint64_t largest_size = params.size_sweep.empty() ? params.region_size
+                                                      : *std::max_element(params.size_sweep.begin(), params.size_sweep.end());
+    if (params.region_offset % params.page_size || params.region_size % params.page_size ||
+        std::any_of(params.size_sweep.begin(), params.size_sweep.end(), [&](uint64_t size) { return size % params.page_size; })) {
+        std::cerr << "Error: --offset, --size and --size_sweep must be multiples of the page size.\n";
+        exit(1);
+    }
+    if (params.region_size == 0) {
+        // the rest of the device, down to whole pages
+        params.region_size = (params.region_offset < static_cast<uint64_t>(params.device_size))
+                                 ? (params.device_size - params.region_offset) / params.page_size * params.page_size : 0;
+    }
+    if (!params.size_sweep.empty()) {
+        params.region_size = params.size_sweep.front();
+    }
+    if (params.region_offset + std::max(params.region_size, largest_size) > static_cast<uint64_t>(params.device_size)) {
+        std::cerr << "Error: The region extends past the end of the device.\n";
+        exit(1);
+    }
+    for (uint64_t size : params.size_sweep.empty() ? std::vector<uint64_t>{params.region_size} : params.size_sweep) {
+        uint64_t partitions = params.region_mode == "disjoint" ? params.threads : 1;
+        if (size / params.page_size < partitions) {
+            std::cerr << "Error: The region needs at least one page per " << (partitions > 1 ? "thread" : "run") << ".\n";
+            exit(1);
+        }
+    }
+    if (params.workload == "wal" && params.region_size < 4 * KIBI * KIBI + params.page_size) {
+        std::cerr << "Error: --workload=wal needs a region of at least one log buffer (4 MiB + page size).\n";
+        exit(1);
+    }
+    params.total_num_pages = params.region_size / params.page_size;
+
+    if (params.replay) {
+        map_replay_to_device(params.replay, params.region_offset, params.region_size, get_logical_block_size(params.fd));
+    }
 
     // if write check if user is okay with data loss
-    if (params.read_or_write == "write" && !params.skip_confirmation) {
+    if (writes && !params.skip_confirmation) {
         std::cout << "\n\033[1;31m*** WARNING: Data Loss Risk ***\033[0m\n"
                   << "This will erase all data in: \033[1;31m" << params.location << "\033[0m\n"
                   << "Size: \033[1;31m" << byte_conversion(params.device_size , "binary")
@@ -157,11 +734,24 @@ benchmark_params parse_arguments(int argc, char *argv[]) {
     }
 
     std::cout << "Location: " << params.location
-          << "\tPage Size: " << params.page_size
-          << "\tMethod: " << params.seq_or_rand
-          << "\tType: " << params.read_or_write;
+          << "\tPage Size: " << params.page_size;
+    if (params.workload == "wal") {
+        std::cout << "\tWorkload: WAL (record " << params.wal_record_size << " bytes, group "
+                  << params.wal_group_size << ", timeout " << params.wal_group_timeout_us << " us)";
+    } else {
+        std::cout << "\tMethod: " << params.seq_or_rand
+                  << "\tType: " << params.read_or_write;
+    }
 
-    if (params.time_based) {
+    if (params.replay) {
+        std::cout << "\tExecution Type: Replay"
+                << "\tReplay: " << params.replay_path << " (" << params.replay->entries.size() << " requests, ";
+        if (params.replay_speed > 0) {
+            std::cout << params.replay_speed << "x)";
+        } else {
+            std::cout << "as fast as possible)";
+        }
+    } else if (params.time_based) {
         std::cout << "\tExecution Type: Time-Based"
                 << "\tDuration: " << params.duration << " seconds";
     } else {
@@ -172,8 +762,85 @@ benchmark_params parse_arguments(int argc, char *argv[]) {
     std::cout << "\tThreads: " << params.threads
             << "\tQueue Depth: " << params.queue_depth
             // << "\tI/O Mode: " << (params.use_sync ? "Synchronous" : "Asynchronous") 
-            << "\tEngine: " << params.engine
-            << std::endl;
+            << "\tEngine: " << params.engine;
+    if (params.engine == "coro") {
+        std::cout << "\tStreams: " << params.streams << "\tChain: " << params.chain;
+    }
+    if (params.region_offset || params.region_size != static_cast<uint64_t>(params.device_size) || !params.size_sweep.empty()) {
+        std::cout << "\tRegion: " << byte_conversion(params.region_offset, "binary") << " + "
+                  << (params.size_sweep.empty() ? byte_conversion(params.region_size, "binary") : "sweep");
+    }
+    std::cout << "\tRegion Mode: " << params.region_mode;
+
+    if (!params.trace_path.empty()) {
+        std::cout << "\tTrace: " << params.trace_path;
+    }
+    if (!params.precondition.empty()) {
+        std::cout << "\tPrecondition: " << params.precondition;
+    }
+    if (params.flush_interval) {
+        std::cout << "\tFlush: " << (params.flush_datasync ? "fdatasync" : "fsync")
+                  << " every " << params.flush_interval << " writes" << (params.link_flush ? " (linked)" : "");
+    }
+    if (params.odsync) {
+        std::cout << "\tOpen: O_DSYNC";
+    }
+    if (params.rate_iops) {
+        std::cout << "\tRate: " << params.rate_iops << " IOPS";
+    }
+    if (!params.ioprio_spec.empty()) {
+        std::cout << "\tI/O Priority: " << params.ioprio_spec;
+    }
+    if (params.outliers) {
+        std::cout << "\tOutliers: " << params.outliers;
+    }
+    if (!params.pipeline_spec.empty()) {
+        std::cout << "\tPipeline: " << params.pipeline_spec << " x" << params.compute_threads;
+    }
+    if (params.attach_wq) {
+        std::cout << "\tWorker Pool: attached";
+    }
+    if (params.submitters > 1) {
+        std::cout << "\tSubmitters: " << params.submitters << " per ring";
+    }
+    if (params.coalesce > 1) {
+        std::cout << "\tCoalesce: up to " << params.coalesce << " I/Os";
+    }
+    if (!params.thread_sweep.empty()) {
+        std::cout << "\tThread Sweep: " << params.thread_sweep.size() << " steps";
+    }
+    if (params.repeat > 1) {
+        std::cout << "\tRepeat: " << params.repeat << " runs";
+    }
+    if (params.verify != verify_algorithm::none) {
+        std::cout << "\tVerify: " << (params.verify == verify_algorithm::crc32c ? "crc32c" : "xxh3");
+    }
+    if (params.find_max_iops) {
+        std::cout << "\tFind Max IOPS: " << params.slo;
+    }
+    if (params.engine != "sync") {
+        std::cout << "\tWait: " << (params.wait_spec.empty() ? (params.engine == "liburing" ? "peek" : "block")
+                                                              : params.wait_spec);
+    }
+    if (params.setup_flags || params.cq_entries || params.register_ring_fd) {
+        std::cout << "\tRing Setup: " << (setup_flags_spec.empty() ? "default" : setup_flags_spec)
+                  << ", CQ " << (params.cq_entries ? std::to_string(params.cq_entries) : "default")
+                  << (params.register_ring_fd ? ", registered fd" : "");
+    }
+    std::cout << std::endl;
+
+    if (params.engine != "sync") {
+        uring_support support = probe_uring_support();
+        print_uring_support(support);
+        if ((params.setup_flags & ~support.setup_flags) || (params.register_ring_fd && !support.register_ring_fd)) {
+            std::cerr << "Error: The kernel does not support the requested io_uring setup.\n";
+            exit(1);
+        }
+        if (params.cq_entries && !(support.setup_flags & IORING_SETUP_CQSIZE)) {
+            std::cerr << "Error: The kernel does not support --cq_entries.\n";
+            exit(1);
+        }
+    }
 
 
     return params;
@@ -186,14 +853,56 @@ void print_help(const char *program_name) {
               << "  --location=<location>              Device location (required, e.g., /dev/sda)\n"
               << "  --page_size=<size>                 Page size (default: 4096)\n"
               << "  --method=<seq|rand>                Access method (default: seq)\n"
-              << "  --type=<read|write>                Operation type (default: read)\n"
+              << "  --type=<read|write|trim|write_zeroes> Operation type (default: read; trim and write_zeroes: sync engine)\n"
               << "  --io=<value>                       Number of IO requests (default: 10000)\n"
               << "  --threads=<threads>                Number of threads (default: 1)\n"
               << "  --queue_depth=<depth>              Queue depth (default: 1)\n"
-              << "  --engine=<sync|liburing|io_uring>  I/O engine to use (default: sync)\n"
+              << "  --engine=<sync|liburing|io_uring|coro> I/O engine to use (default: sync)\n"
               << "  -y                                 Skip confirmation for write operation because of data loss\n"
               << "  --time                             Enable time-based benchmarking\n"
-              << "  --duration=<seconds>               Duration in seconds for time-based benchmarking\n";
+              << "  --duration=<seconds>               Duration in seconds for time-based benchmarking\n"
+              << "  --trace=<file>                     Record every I/O to a binary trace (convert with io_trace2csv)\n"
+              << "  --replay=<file>                    Replay a blkparse or CSV (timestamp,op,offset,size) trace\n"
+              << "  --replay_speed=<factor|afap>       Replay timing: 1 = original (default), 2 = twice as fast, afap = no delays\n"
+              << "  --precondition=<steps>             Fill the device before measuring: seq-fill,rand-fill:N (not counted in results)\n"
+              << "  --latency_breakdown                Split io_uring latency into submit delay, device time and reap lag\n"
+              << "  --fsync=<N>                        Issue fsync after every N writes (time/IO-based runs)\n"
+              << "  --fdatasync=<N>                    Issue fdatasync after every N writes (time/IO-based runs)\n"
+              << "  --link_flush                       Link each flush to the preceding write with IOSQE_IO_LINK (io_uring engines)\n"
+              << "  --odsync                           Open the device with O_DSYNC\n"
+              << "  --workload=<io|wal>                io: fixed-size requests (default), wal: append log with group commit\n"
+              << "  --wal_record_size=<bytes>          WAL record appended per commit (default: 512)\n"
+              << "  --wal_group_size=<N>               Flush a WAL group once N records are pending (default: 8)\n"
+              << "  --wal_group_timeout=<us>           Flush earlier when the oldest record waited this long (default: 200)\n"
+              << "  --find-max-iops                    Search threads (<= --threads) and queue depth (<= --queue_depth) for the\n"
+              << "                                     highest IOPS meeting --slo; --duration is the time per step\n"
+              << "  --slo=p<N>:<latency>               Latency target for --find-max-iops, e.g. p99:500us, p99.9:2ms\n"
+              << "  --setup_flags=<list>               liburing ring setup: single_issuer,defer_taskrun,coop_taskrun\n"
+              << "  --cq_entries=<N>                   liburing completion queue size (default: 2x queue depth)\n"
+              << "  --register_ring_fd                 Register each liburing ring fd (io_uring_register_ring_fd)\n"
+              << "  --wait=<strategy>                  Completion wait of the io_uring engines: peek, block, timeout:<us>,\n"
+              << "                                     hybrid:<spin_us> (default: peek for liburing, block otherwise)\n"
+              << "  --streams=<N>                      Coroutine streams per thread for --engine=coro (default: 1024)\n"
+              << "  --chain=<N>                        Dependent I/Os per coro stream request (default: 1)\n"
+              << "  --offset=<bytes>                   Start of the tested region, e.g. 10G (default: 0)\n"
+              << "  --size=<bytes>                     Size of the tested region, e.g. 1G (default: rest of the device)\n"
+              << "  --region=<shared|disjoint>         Threads share the region or get 1/threads each\n"
+              << "                                     (default: disjoint for seq, shared for rand)\n"
+              << "  --size_sweep=<sizes>               Measure each region size in turn, e.g. 256M,1G,4G,16G\n"
+              << "  --rate_iops=<N>                    Limit the run to N I/Os per second, split evenly over the threads\n"
+              << "  --jobs=<file>                      Run the jobs of an INI job file concurrently (see README)\n"
+              << "  --ioprio=<rt:N|be:N|idle|none>     I/O priority class and level 0-7 (ioprio_set for sync, sqe->ioprio otherwise)\n"
+              << "  --outliers=<K>                     Keep the K slowest I/Os and report them by time and offset\n"
+              << "  --verify=<crc32c|xxh3>             Stamp written blocks with a checksum, check reads and read writes back\n"
+              << "  --pipeline=<checksum|memcpy|spin:N> Hand completed reads to compute workers (spin: N ns per byte)\n"
+              << "  --compute_threads=<N>              Compute workers for --pipeline (default: 1)\n"
+              << "  --attach_wq                        Create all io_uring rings with IORING_SETUP_ATTACH_WQ on one shared io-wq\n"
+              << "  --submitters=<N>                   Threads sharing one liburing ring, one ring per core (default: 1)\n"
+              << "  --thread_sweep=<counts>            Measure each thread count in turn against ring-per-thread, e.g. 1,2,4,8,16\n"
+              << "  --coalesce=<N>                     Merge up to N contiguous --method=seq I/Os into one readv/writev (sync, liburing)\n"
+              << "  --repeat=<N>                       Run N times and report mean, stddev and 95% confidence intervals\n"
+              << "  --json=<file>                      Save the --repeat runs as a baseline for --compare\n"
+              << "  --compare=<file>                   Flag statistically significant regressions against a --json baseline\n";
               
 }
 
@@ -215,24 +924,31 @@ std::string byte_conversion(unsigned long long bytes, const std::string &unit)
 }
 
 
+page_range get_thread_pages(const benchmark_params &params, uint64_t thread_id) {
+    uint64_t region_pages = params.region_size / params.page_size;
+    page_range range = {params.region_offset / params.page_size, region_pages};
+    if (params.region_mode == "disjoint") {
+        range.count = region_pages / params.threads;
+        range.first += thread_id * range.count;
+    }
+    return range;
+}
+
 std::vector<uint64_t> generate_offsets(const benchmark_params &params, uint64_t thread_id) {
     std::vector<uint64_t> offsets(params.io);
-    uint64_t avoid = KILO * KILO *KILO; // Add 1GB to offset
+    page_range pages = get_thread_pages(params, thread_id);
 
     if (params.seq_or_rand == "seq") {
+        // in a shared region threads start spread out instead of reading the same pages
+        uint64_t start = (params.region_mode == "disjoint") ? 0 : thread_id * (pages.count / params.threads);
         for (uint64_t i = 0; i < params.io; ++i) {
-            offsets[i] = ((i * params.page_size) + thread_id * params.io * params.page_size) % params.device_size;
+            offsets[i] = (pages.first + (start + i) % pages.count) * params.page_size;
         }
     } else if (params.seq_or_rand == "rand") {
         std::mt19937_64 rng(std::random_device{}() + thread_id);
-        std::uniform_int_distribution<uint64_t> dist(0, params.total_num_pages - 1);
+        std::uniform_int_distribution<uint64_t> dist(0, pages.count - 1);
         for (uint64_t i = 0; i < params.io; ++i) {
-            uint64_t offset = dist(rng) * params.page_size;
-            // if the offset is within the avoid range, generate a new offset
-            while (offset < avoid) {
-                offset = dist(rng) * params.page_size;
-            }
-            offsets[i] = dist(rng) * params.page_size % params.device_size;
+            offsets[i] = (pages.first + dist(rng)) * params.page_size;
         }
     } else {
         throw std::runtime_error("Invalid method: " + params.seq_or_rand);
@@ -241,6 +957,82 @@ std::vector<uint64_t> generate_offsets(const benchmark_params &params, uint64_t
     return offsets;
 }
 
+uint32_t contiguous_ios(const benchmark_params &params, const std::vector<uint64_t> &offsets, uint64_t first, uint32_t limit) {
+    uint32_t count = 1;
+    while (count < limit &&
+           offsets[(first + count) % params.io] == offsets[(first + count - 1) % params.io] + params.page_size) {
+        count++;
+    }
+    return count;
+}
+
+uint32_t advance_iovecs(struct iovec *iov, uint32_t start, uint32_t count, uint64_t bytes) {
+    while (start < count && bytes >= iov[start].iov_len) {
+        bytes -= iov[start].iov_len;
+        start++;
+    }
+    if (start < count) {
+        iov[start].iov_base = static_cast<char *>(iov[start].iov_base) + bytes;
+        iov[start].iov_len -= bytes;
+    }
+    return start;
+}
+
+uint64_t parse_size(const std::string &text) {
+    size_t pos = 0;
+    uint64_t value = std::stoull(text, &pos);
+    std::string suffix = text.substr(pos);
+    static const std::string units = "KMGT";
+    if (suffix.empty()) {
+        return value;
+    }
+    size_t unit = units.find(toupper(suffix[0]));
+    if (unit == std::string::npos || (suffix.size() > 1 && suffix.substr(1) != "iB" && suffix.substr(1) != "B")) {
+        throw std::invalid_argument("unknown suffix '" + suffix + "' (use K, M, G or T)");
+    }
+    return value << (10 * (unit + 1));
+}
+
+
+uint16_t parse_ioprio(const std::string &spec) {
+    std::string name = spec.substr(0, spec.find(':'));
+    bool has_level = spec.find(':') != std::string::npos;
+    int priority_class;
+    if (name == "rt") {
+        priority_class = IOPRIO_CLASS_RT;
+    } else if (name == "be") {
+        priority_class = IOPRIO_CLASS_BE;
+    } else if (name == "idle" && !has_level) {
+        return IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0);
+    } else if (name == "none" && !has_level) {
+        return IOPRIO_PRIO_VALUE(IOPRIO_CLASS_NONE, 0);
+    } else {
+        throw std::invalid_argument("unknown class '" + spec + "' (use rt:<level>, be:<level>, idle or none)");
+    }
+
+    int level = IOPRIO_NORM;
+    if (has_level) {
+        size_t pos = 0;
+        std::string text = spec.substr(spec.find(':') + 1);
+        level = std::stoi(text, &pos);
+        if (pos != text.size() || level < 0 || level >= IOPRIO_NR_LEVELS) {
+            throw std::invalid_argument("level must be 0 (highest) to 7");
+        }
+    }
+    return IOPRIO_PRIO_VALUE(priority_class, level);
+}
+
+void set_thread_ioprio(const benchmark_params &params)
+{
+    // IOPRIO_WHO_PROCESS with pid 0 is the calling thread. parse_arguments already tried the
+    // priority, so a failure here does not stop the run.
+    if (!params.ioprio_spec.empty() && syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, params.ioprio) < 0)
+    {
+        int err = errno;
+        std::cerr << "Warning: ioprio_set failed: " << strerror(err) << std::endl;
+    }
+}
+
 
 uint32_t acquire_buffer(bool *is_buffer_free, uint64_t queue_depth)
 {
@@ -266,6 +1058,11 @@ std::pair<uint32_t, uint32_t> extractBoth32(uint64_t combined) {
     return {buffer_id, request_id};
 }
 
+trace_ring *get_trace_ring(const benchmark_params &params, uint64_t thread_id)
+{
+    return params.trace ? &params.trace->rings[thread_id] : nullptr;
+}
+
 void pin_thread(uint64_t thread_id)
 {
     cpu_set_t cpuset;
@@ -277,3 +1074,12 @@ void pin_thread(uint64_t thread_id)
         std::cerr << "Error: Unable to pin thread to core\n";
     }
 }
+
+uint64_t rate_due_time(const benchmark_params &params, uint64_t start_time, uint64_t n)
+{
+    if (params.rate_iops == 0)
+    {
+        return 0;
+    }
+    return start_time + static_cast<uint64_t>(n * 1e9 * params.threads / params.rate_iops);
+}
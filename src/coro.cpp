@@ -0,0 +1,288 @@
+#include "coro.h"
+#include "async.h"
+#include "trace.h"
+#include "verify.h"
+#include <coroutine>
+
+// Per-thread scheduler: one ring shared by all streams of the thread
+struct stream_scheduler
+{
+    struct io_uring ring;
+    const benchmark_params &params;
+    thread_stats &stats;
+    trace_ring *trace;
+    uint64_t thread_id;
+    uint64_t in_flight = 0;
+    bool stopping = false; // set at the end of the run; streams finish their current request
+    std::vector<struct io_uring_cqe *> cqes{};
+    std::vector<struct io_operation *> reaped{}; // completed, waiting to be resumed
+};
+
+static unsigned reap_completions(stream_scheduler &scheduler);
+
+// Coroutine of one logical stream. It starts suspended and stays suspended at the end, so
+// the scheduler owns the frame and destroys it after the ring has drained.
+struct stream_task
+{
+    struct promise_type
+    {
+        stream_task get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// co_await target for one read or write. Its address is the SQE user_data; the scheduler
+// stores the CQE result and resumes the stream.
+struct io_operation
+{
+    stream_scheduler &scheduler;
+    bool write;
+    char *buffer;
+    uint64_t offset;
+    uint32_t size;
+
+    int result = 0;
+    uint64_t prep_time = 0;
+    uint64_t in_flight = 0; // on the thread once this one was queued, for --outliers
+    std::coroutine_handle<> waiter;
+
+    io_operation(stream_scheduler &scheduler, bool write, char *buffer, uint64_t offset, uint32_t size)
+        : scheduler(scheduler), write(write), buffer(buffer), offset(offset), size(size)
+    {
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        waiter = handle;
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&scheduler.ring);
+        while (!sqe)
+        {
+            // SQ full: hand the queued entries to the kernel to make room
+            int ret = io_uring_submit(&scheduler.ring);
+            if (ret == -EBUSY || ret == -EAGAIN)
+            {
+                // the CQ is full or the kernel is short of resources: free CQ space, or wait
+                // for a completion if there is none to take
+                struct io_uring_cqe *cqe;
+                if (reap_completions(scheduler) == 0 && io_uring_wait_cqe(&scheduler.ring, &cqe) == 0)
+                {
+                    reap_completions(scheduler);
+                }
+            }
+            else if (ret < 0 && ret != -EINTR)
+            {
+                throw std::runtime_error("io_uring_submit failed: " + std::string(strerror(-ret)));
+            }
+            sqe = io_uring_get_sqe(&scheduler.ring);
+        }
+        if (write)
+        {
+            io_uring_prep_write(sqe, scheduler.params.fd, buffer, size, offset);
+        }
+        else
+        {
+            io_uring_prep_read(sqe, scheduler.params.fd, buffer, size, offset);
+        }
+        sqe->ioprio = scheduler.params.ioprio;
+        io_uring_sqe_set_data(sqe, this);
+        prep_time = get_current_time_ns();
+        in_flight = ++scheduler.in_flight;
+    }
+
+    int await_resume() const noexcept { return result; }
+};
+
+// Store the results of all visible CQEs and queue their streams for resumption. Streams are
+// resumed by the scheduler loop only, never from inside another stream's co_await.
+static unsigned reap_completions(stream_scheduler &scheduler)
+{
+    unsigned count = io_uring_peek_batch_cqe(&scheduler.ring, scheduler.cqes.data(), scheduler.cqes.size());
+    for (unsigned i = 0; i < count; i++)
+    {
+        io_operation *op = static_cast<io_operation *>(io_uring_cqe_get_data(scheduler.cqes[i]));
+        op->result = scheduler.cqes[i]->res;
+        scheduler.reaped.push_back(op);
+    }
+    io_uring_cq_advance(&scheduler.ring, count);
+    scheduler.in_flight -= count;
+    return count;
+}
+
+// splitmix64: cheap per-stream random numbers
+static inline uint64_t next_random(uint64_t &state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static stream_task run_stream(stream_scheduler &scheduler, uint64_t stream_id, char *buffer, uint64_t seed)
+{
+    const benchmark_params &params = scheduler.params;
+    thread_stats &stats = scheduler.stats;
+    page_range pages = get_thread_pages(params, scheduler.thread_id);
+    bool write = params.read_or_write == "write";
+    uint64_t state = seed;
+    // --method=seq: every stream walks its own slice of the thread's pages, wrapping around
+    bool seq = params.seq_or_rand == "seq";
+    uint64_t cursor = stream_id * pages.count / params.streams;
+    auto next_page = [&](uint64_t key) {
+        return pages.first + (seq ? cursor++ : key ^ next_random(state)) % pages.count;
+    };
+
+    while (!scheduler.stopping)
+    {
+        uint64_t request_start = get_current_time_ns();
+        uint64_t page = next_page(0);
+
+        for (uint64_t step = 0; step < params.chain; step++)
+        {
+            if (write)
+            {
+                verify_write(params, stats, buffer, page * params.page_size, scheduler.thread_id);
+            }
+            io_operation op{scheduler, write, buffer, page * params.page_size, static_cast<uint32_t>(params.page_size)};
+            int res = co_await op;
+            uint64_t completion_time = get_current_time_ns();
+
+            if (res < 0)
+            {
+                std::cerr << "I/O error: " << strerror(-res) << std::endl;
+            }
+            stats.latency.record(completion_time - op.prep_time);
+            record_outlier(stats.outliers, write ? TRACE_OP_WRITE : TRACE_OP_READ, op.offset, op.size, op.prep_time,
+                           completion_time - op.prep_time, op.in_flight);
+            stats.io_completed++;
+            if (!write && res == static_cast<int>(op.size))
+            {
+                verify_read(params.verify, stats, buffer, op.size, op.offset);
+            }
+            if (scheduler.trace)
+            {
+                trace_push(scheduler.trace, write ? TRACE_OP_WRITE : TRACE_OP_READ, op.offset, op.size,
+                           op.prep_time, completion_time, res);
+            }
+
+            // reads: the next page depends on the data just read, so it cannot be issued earlier
+            // (with --method=seq it is simply the next one, still issued only now)
+            if (step + 1 < params.chain)
+            {
+                uint64_t key = 0;
+                if (!write)
+                {
+                    memcpy(&key, buffer, sizeof(key));
+                }
+                page = next_page(key);
+            }
+        }
+
+        stats.request_latency.record(get_current_time_ns() - request_start);
+        stats.requests_completed++;
+        stats.stream_requests[stream_id]++;
+    }
+}
+
+void time_benchmark_thread_coro(benchmark_params &params, thread_stats &stats, uint64_t thread_id)
+{
+    pin_thread(params.first_cpu + thread_id);
+
+    stream_scheduler scheduler{{}, params, stats, get_trace_ring(params, thread_id), thread_id};
+    init_liburing_ring(params, &scheduler.ring, params.queue_depth);
+
+    char *buffers = nullptr;
+    if (posix_memalign((void **)&buffers, params.page_size, params.streams * params.page_size) != 0)
+    {
+        throw std::runtime_error("Error allocating buffer: " + std::string(strerror(errno)));
+    }
+    memset(buffers, 0, params.streams * params.page_size);
+    verify_prepare_buffer(params, buffers, params.streams * params.page_size);
+    stats.stream_requests.assign(params.streams, 0);
+
+    std::vector<stream_task> streams;
+    streams.reserve(params.streams);
+    scheduler.cqes.resize(params.queue_depth);
+    std::vector<io_operation *> ready;
+
+    stats.start_time = get_current_time_ns();
+
+    // every stream runs up to its first co_await
+    std::mt19937_64 rng(std::random_device{}() + thread_id);
+    for (uint64_t i = 0; i < params.streams; i++)
+    {
+        streams.push_back(run_stream(scheduler, i, buffers + i * params.page_size, rng()));
+        streams.back().handle.resume();
+    }
+
+    while (scheduler.in_flight > 0 || !scheduler.reaped.empty())
+    {
+        if (!scheduler.stopping && get_current_time_ns() - stats.start_time >= params.duration * 1e9)
+        {
+            scheduler.stopping = true;
+        }
+
+        if (scheduler.in_flight > 0)
+        {
+            int ret = submit_and_wait(&scheduler.ring, params);
+            if (ret < 0)
+            {
+                throw std::runtime_error("io_uring_submit failed: " + std::string(strerror(-ret)));
+            }
+            reap_completions(scheduler);
+        }
+
+        // CQEs are released before resuming: a stream may queue its next I/O right away and
+        // reap more completions while it waits for SQ space
+        while (!scheduler.reaped.empty())
+        {
+            ready.swap(scheduler.reaped);
+            for (io_operation *op : ready)
+            {
+                op->waiter.resume();
+            }
+            ready.clear();
+        }
+    }
+
+    stats.end_time = get_current_time_ns();
+
+    for (auto &stream : streams)
+    {
+        stream.handle.destroy();
+    }
+    free(buffers);
+    io_uring_queue_exit(&scheduler.ring);
+}
+
+void print_stream_summary(const benchmark_params &params, const std::vector<thread_stats> &thread_stats_list, double total_time)
+{
+    uint64_t requests = 0;
+    uint64_t min_requests = UINT64_MAX, max_requests = 0;
+    latency_histogram request_latency;
+
+    for (const auto &stats : thread_stats_list)
+    {
+        requests += stats.requests_completed;
+        request_latency.merge(stats.request_latency);
+        for (uint64_t count : stats.stream_requests)
+        {
+            min_requests = std::min(min_requests, count);
+            max_requests = std::max(max_requests, count);
+        }
+    }
+
+    uint64_t total_streams = params.streams * params.threads;
+    std::cout << "Streams: " << total_streams << " (" << params.streams << " per thread), Chain: "
+              << params.chain << " I/Os per request" << std::endl;
+    std::cout << "Requests Completed: " << requests << " (" << requests / total_time << " requests/s)"
+              << ", per stream: min " << min_requests << ", mean " << double(requests) / total_streams
+              << ", max " << max_requests << std::endl;
+    print_latency_summary("Request Latency", request_latency);
+}
@@ -0,0 +1,117 @@
+#include "histogram.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+void latency_histogram::merge(const latency_histogram &other)
+{
+    for (uint64_t i = 0; i < num_buckets; i++)
+    {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
+
+uint64_t histogram_bucket_floor(uint64_t index)
+{
+    if (index < latency_histogram::sub_buckets)
+    {
+        return index;
+    }
+    uint64_t shift = index / latency_histogram::sub_buckets - 1;
+    uint64_t sub = index % latency_histogram::sub_buckets;
+    return (latency_histogram::sub_buckets + sub) << shift;
+}
+
+uint64_t latency_histogram::percentile(double p) const
+{
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * total + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, total));
+
+    uint64_t seen = 0;
+    for (uint64_t i = 0; i < num_buckets; i++)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            // report the middle of the bucket, clamped to what was actually observed
+            uint64_t low = histogram_bucket_floor(i);
+            uint64_t high = histogram_bucket_floor(i + 1);
+            return std::min(max, std::max(min, low + (high - low) / 2));
+        }
+    }
+    return max;
+}
+
+void print_latency_summary(const std::string &name, const latency_histogram &h)
+{
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2);
+    line << name << " (us): count " << h.total;
+    if (h.total)
+    {
+        line << ", min " << h.min / 1e3
+             << ", mean " << h.mean() / 1e3
+             << ", p50 " << h.percentile(50) / 1e3
+             << ", p90 " << h.percentile(90) / 1e3
+             << ", p99 " << h.percentile(99) / 1e3
+             << ", p99.9 " << h.percentile(99.9) / 1e3
+             << ", p99.99 " << h.percentile(99.99) / 1e3
+             << ", max " << h.max / 1e3;
+    }
+    std::cout << line.str() << std::endl;
+}
+
+void print_latency_histograms(const std::vector<std::string> &names, const std::vector<const latency_histogram *> &histograms)
+{
+    // Collapse the sub-buckets into power-of-two buckets: [0,1us), [1,2us), [2,4us), ...
+    static constexpr int rows = 32;
+    std::vector<std::vector<uint64_t>> table(histograms.size(), std::vector<uint64_t>(rows, 0));
+    int first = rows, last = -1;
+
+    for (size_t h = 0; h < histograms.size(); h++)
+    {
+        for (uint64_t i = 0; i < latency_histogram::num_buckets; i++)
+        {
+            uint64_t count = histograms[h]->counts[i];
+            if (count == 0)
+            {
+                continue;
+            }
+            uint64_t us = histogram_bucket_floor(i) / 1000;
+            int row = us == 0 ? 0 : std::min(rows - 1, 64 - __builtin_clzll(us));
+            table[h][row] += count;
+            first = std::min(first, row);
+            last = std::max(last, row);
+        }
+    }
+
+    std::ostringstream out;
+    out << std::left << std::setw(20) << "Latency (us)";
+    for (const auto &name : names)
+    {
+        out << std::right << std::setw(16) << name;
+    }
+    out << "\n";
+
+    for (int row = first; row <= last; row++)
+    {
+        std::string range = row == 0 ? "[0, 1)" : "[" + std::to_string(1ULL << (row - 1)) + ", " + std::to_string(1ULL << row) + ")";
+        out << std::left << std::setw(20) << range;
+        for (size_t h = 0; h < histograms.size(); h++)
+        {
+            out << std::right << std::setw(16) << table[h][row];
+        }
+        out << "\n";
+    }
+    std::cout << out.str() << std::flush;
+}
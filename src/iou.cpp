@@ -1,9 +1,13 @@
 #include "iou.h"
 #include "config.h"
+#include "trace.h"
+#include "replay.h"
+#include "verify.h"
+#include "pipeline.h"
 #include <condition_variable>
 
 
-int app_setup_uring(struct submitter *s, int queue_depth)
+int app_setup_uring(struct submitter *s, int queue_depth, int wq_fd)
 {
     struct app_io_sq_ring *sring = &s->sq_ring;
     struct app_io_cq_ring *cring = &s->cq_ring;
@@ -11,6 +15,10 @@ int app_setup_uring(struct submitter *s, int queue_depth)
     void *sq_ptr, *cq_ptr;
 
     memset(&p, 0, sizeof(p));
+    if (wq_fd >= 0) {
+        p.flags = IORING_SETUP_ATTACH_WQ;
+        p.wq_fd = wq_fd;
+    }
     s->ring_fd = io_uring_setup(queue_depth, &p);
     if (s->ring_fd < 0) {
         perror("io_uring_setup");
@@ -35,6 +43,9 @@ int app_setup_uring(struct submitter *s, int queue_depth)
         return 1;
     }
 
+    s->sq_ptr = sq_ptr;
+    s->sring_sz = sring_sz;
+
     if (p.features & IORING_FEAT_SINGLE_MMAP) {
         cq_ptr = sq_ptr;
     } else {
@@ -47,6 +58,9 @@ int app_setup_uring(struct submitter *s, int queue_depth)
         }
     }
 
+    s->cq_ptr = cq_ptr;
+    s->cring_sz = cring_sz;
+
     /* Correct pointer calculations */
     sring->head = (unsigned *)((char *)sq_ptr + p.sq_off.head);
     sring->tail = (unsigned *)((char *)sq_ptr + p.sq_off.tail);
@@ -63,6 +77,7 @@ int app_setup_uring(struct submitter *s, int queue_depth)
         perror("mmap");
         return 1;
     }
+    s->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
 
     cring->head = (unsigned *)((char *)cq_ptr + p.cq_off.head);
     cring->tail = (unsigned *)((char *)cq_ptr + p.cq_off.tail);
@@ -72,7 +87,19 @@ int app_setup_uring(struct submitter *s, int queue_depth)
 
     return 0;
 }
-void submit_io(struct submitter *s, int fd, size_t block_size, off_t offset, bool is_read, struct io_data *io, char *buffer, int buffer_id, int request_id)
+
+void app_teardown_uring(struct submitter *s)
+{
+    munmap(s->sqes, s->sqes_sz);
+    if (s->cq_ptr && s->cq_ptr != s->sq_ptr)
+    {
+        munmap(s->cq_ptr, s->cring_sz);
+    }
+    munmap(s->sq_ptr, s->sring_sz);
+    close(s->ring_fd);
+}
+
+struct io_uring_sqe *submit_io(struct submitter *s, int fd, size_t block_size, off_t offset, bool is_read, struct io_data *io, char *buffer, int buffer_id, int request_id)
 {
     struct app_io_sq_ring *sring = &s->sq_ring;
     unsigned tail, index;
@@ -88,6 +115,7 @@ void submit_io(struct submitter *s, int fd, size_t block_size, off_t offset, boo
     io->buf = buffer;
     io->buffer_id = buffer_id;
     io->request_id = request_id;
+    io->op = is_read ? TRACE_OP_READ : TRACE_OP_WRITE;
 
     sqe->fd = fd;
     sqe->addr = (unsigned long)io->buf;
@@ -108,30 +136,111 @@ void submit_io(struct submitter *s, int fd, size_t block_size, off_t offset, boo
     tail++;
     *sring->tail = tail;
     write_barrier();
+
+    return sqe;
+}
+
+void submit_flush(struct submitter *s, int fd, bool datasync, struct io_data *io)
+{
+    struct app_io_sq_ring *sring = &s->sq_ring;
+    unsigned tail = *sring->tail;
+    unsigned index = tail & *sring->ring_mask;
+
+    struct io_uring_sqe *sqe = &s->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+
+    io->length = 0;
+    io->offset = 0;
+    io->buf = nullptr;
+    io->op = TRACE_OP_FLUSH;
+
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->fsync_flags = datasync ? IORING_FSYNC_DATASYNC : 0;
+    sqe->user_data = (unsigned long long)io;
+
+    sring->array[index] = index;
+    tail++;
+    *sring->tail = tail;
+    write_barrier();
 }
 
-void reap_cqes(struct submitter *s, uint64_t &completed_ios, bool *is_buffer_free)
+void reap_cqes(struct submitter *s, thread_stats &stats, bool *is_buffer_free, trace_ring *trace, bool latency_breakdown,
+               verify_algorithm verify, pipeline_port *pipeline)
 {
     struct app_io_cq_ring *cring = &s->cq_ring;
     unsigned head = *cring->head;
+    if (head == *cring->tail)
+    {
+        return; // nothing to reap, e.g. an empty poll with --wait=peek
+    }
+
+    // the CQEs became visible to this thread when io_uring_enter returned; one timestamp per batch
+    uint64_t seen_time = get_current_time_ns();
 
     while (head != *cring->tail)
     {
         read_barrier();
         struct io_uring_cqe *cqe = &cring->cqes[head & *cring->ring_mask];
         struct io_data *io = (struct io_data *)cqe->user_data;
+        io->result = cqe->res;
+
+        if (io->op == TRACE_OP_FLUSH)
+        {
+            // linked flushes are cancelled when their write fails
+            uint64_t completion_time = latency_breakdown ? get_current_time_ns() : seen_time;
+            if (cqe->res < 0)
+            {
+                std::cerr << "Flush error: " << strerror(-cqe->res) << std::endl;
+            }
+            stats.flush_latency.record(completion_time - io->prep_time);
+            stats.flushes_completed++;
+            if (trace)
+            {
+                trace_push(trace, TRACE_OP_FLUSH, 0, 0, io->prep_time, completion_time, cqe->res);
+            }
+            head++;
+            continue;
+        }
 
         if (cqe->res < 0)
         {
             std::cerr << "I/O error: " << strerror(-cqe->res) << std::endl;
         }
-        else if ((size_t)cqe->res != io->length)
+        else
+        {
+            if ((size_t)cqe->res != io->length)
+            {
+                std::cerr << "Partial I/O: " << cqe->res << " bytes" << std::endl;
+            }
+            stats.bytes_completed += cqe->res;
+        }
+
+        uint64_t completion_time = latency_breakdown ? get_current_time_ns() : seen_time;
+        stats.latency.record(completion_time - io->prep_time);
+        record_outlier(stats.outliers, io->op, io->offset, io->length, io->prep_time, completion_time - io->prep_time, io->in_flight);
+        if (io->op == TRACE_OP_READ && (size_t)cqe->res == io->length)
+        {
+            verify_read(verify, stats, static_cast<const char *>(io->buf), io->length, io->offset);
+        }
+        if (latency_breakdown)
         {
-            std::cerr << "Partial I/O: " << cqe->res << " bytes" << std::endl;
+            stats.submit_delay.record(io->submit_time - io->prep_time);
+            stats.device_time.record(seen_time - io->submit_time);
+            stats.reap_lag.record(completion_time - seen_time);
         }
 
-        // Mark the buffer as free for reuse
-        if (io->buffer_id >= 0) {  // Ensure buffer_id is valid
+        if (trace)
+        {
+            trace_push(trace, io->op, io->offset, io->length,
+                       io->prep_time, completion_time, cqe->res);
+        }
+
+        // Mark the buffer as free for reuse, or hand a completed read to the compute stage
+        if (pipeline && io->op == TRACE_OP_READ && (size_t)cqe->res == io->length) {
+            pipeline_hand_off(pipeline, io->buffer_id, static_cast<char *>(io->buf), io->length, completion_time);
+        }
+        else if (io->buffer_id >= 0) {  // Ensure buffer_id is valid
             is_buffer_free[io->buffer_id] = true;
         }
         else {
@@ -139,13 +248,60 @@ void reap_cqes(struct submitter *s, uint64_t &completed_ios, bool *is_buffer_fre
         }
 
         head++;
-        completed_ios++;
+        stats.io_completed++;
     }
 
     *cring->head = head;
     write_barrier();
 }
 
+// Submit to_submit SQEs and wait for completions as selected by --wait.
+// Returns the io_uring_enter result; a timed-out wait is not an error.
+static int submit_and_wait(struct submitter *s, unsigned to_submit, const benchmark_params &params)
+{
+    switch (params.wait)
+    {
+    case wait_strategy::block:
+        return io_uring_enter(s->ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL);
+
+    case wait_strategy::peek:
+        return to_submit ? io_uring_enter(s->ring_fd, to_submit, 0, 0, NULL) : 0;
+
+    case wait_strategy::timeout:
+    {
+        struct __kernel_timespec ts = {0, static_cast<long long>(params.wait_us * KILO)};
+        ts.tv_sec = ts.tv_nsec / 1000000000;
+        ts.tv_nsec %= 1000000000;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        int ret = io_uring_enter2(s->ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                                  reinterpret_cast<sigset_t *>(&arg), sizeof(arg));
+        return ret == -ETIME ? 0 : ret;
+    }
+
+    case wait_strategy::hybrid:
+    {
+        int ret = to_submit ? io_uring_enter(s->ring_fd, to_submit, 0, 0, NULL) : 0;
+        if (ret < 0)
+        {
+            return ret;
+        }
+        // poll the CQ ring for wait_us before falling back to a blocking wait
+        uint64_t spin_end = get_current_time_ns() + params.wait_us * KILO;
+        while (*s->cq_ring.head == __atomic_load_n(s->cq_ring.tail, __ATOMIC_ACQUIRE))
+        {
+            if (get_current_time_ns() >= spin_end)
+            {
+                return io_uring_enter(s->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL);
+            }
+        }
+        return ret;
+    }
+    }
+    return 0;
+}
+
 void io_benchmark_thread_iou(benchmark_params &params, thread_stats &stats, uint64_t thread_id)
 {
 
@@ -156,16 +312,18 @@ void io_benchmark_thread_iou(benchmark_params &params, thread_stats &stats, uint
 void time_benchmark_thread_iou(benchmark_params &params, thread_stats &stats, uint64_t thread_id)
 {
 
-    pin_thread(thread_id);
+    pin_thread(params.first_cpu + thread_id);
     std::cout << "Pin thread " << thread_id << std::endl;
 
 
     params.io = params.duration * 1e6; // estimate number of I/O operations
     std::vector<uint64_t> offsets = generate_offsets(params, thread_id);
+    trace_ring *trace = get_trace_ring(params, thread_id);
+    pipeline_port *pipeline = get_pipeline_port(params, thread_id);
 
     struct submitter *s = new submitter();
 
-    if (app_setup_uring(s, params.queue_depth))
+    if (app_setup_uring(s, params.queue_depth, params.wq_fd))
     {
         throw std::runtime_error("Error setting up io_uring");
     }
@@ -179,11 +337,20 @@ void time_benchmark_thread_iou(benchmark_params &params, thread_stats &stats, ui
         {
             throw std::runtime_error("posix_memalign failed");
         }
+        verify_prepare_buffer(params, buffers[i], params.page_size);
         is_buffer_free[i] = true;
         io_data_pool[i] = new io_data(); // Preallocate io_data structures
     }
 
+    // Flushes count against the queue depth, so at most queue_depth of them are in flight
+    // and their io_data can be reused round-robin
+    std::vector<io_data> flush_pool(params.flush_interval ? params.queue_depth : 0);
+    uint64_t flushes_submitted = 0, writes_since_flush = 0;
+    bool flush_pending = false;
+
     uint64_t submitted = 0, to_submit = 0;
+    std::vector<struct io_data *> batch; // requests of the current submit, for --latency_breakdown
+    batch.reserve(params.queue_depth);
 
     stats.start_time = get_current_time_ns();
 
@@ -195,8 +362,44 @@ void time_benchmark_thread_iou(benchmark_params &params, thread_stats &stats, ui
             break;
         }
 
-        while ((submitted - stats.io_completed) < params.queue_depth)
+        if (pipeline)
+        {
+            pipeline_reclaim(pipeline, is_buffer_free, current_time);
+        }
+
+        while (true)
         {
+            // buffers held by the --pipeline compute stage count against the queue depth too
+            uint64_t in_flight = (submitted - stats.io_completed) + (flushes_submitted - stats.flushes_completed) +
+                                 (pipeline ? pipeline->held() : 0);
+            if (in_flight >= params.queue_depth)
+            {
+                break;
+            }
+
+            if (flush_pending)
+            {
+                // unlinked flush that did not fit next to its write
+                struct io_data *flush = &flush_pool[flushes_submitted % flush_pool.size()];
+                submit_flush(s, params.fd, params.flush_datasync, flush);
+                flush->prep_time = current_time;
+                flushes_submitted++;
+                to_submit++;
+                flush_pending = false;
+                continue;
+            }
+
+            if (rate_due_time(params, stats.start_time, submitted) > current_time)
+            {
+                break; // --rate_iops: the next I/O is not due yet
+            }
+
+            bool flush_after = params.flush_interval && writes_since_flush + 1 >= params.flush_interval;
+            if (flush_after && params.link_flush && in_flight + 2 > params.queue_depth)
+            {
+                break; // the write and its linked flush must be queued together
+            }
+
             uint32_t buffer_id = acquire_buffer(is_buffer_free, params.queue_depth);
             if (buffer_id == -1)
             {
@@ -204,23 +407,108 @@ void time_benchmark_thread_iou(benchmark_params &params, thread_stats &stats, ui
             }
 
             struct io_data *io = io_data_pool[buffer_id]; // Reuse preallocated io_data
-            submit_io(s, params.fd, params.page_size, offsets[submitted], params.read_or_write == "read", io, buffers[buffer_id], buffer_id, submitted);
+            if (params.verify != verify_algorithm::none && params.read_or_write == "write")
+            {
+                // stamp outside the timed region
+                verify_stamp_block(params, stats, buffers[buffer_id], offsets[submitted], thread_id);
+                current_time = get_current_time_ns();
+            }
+            struct io_uring_sqe *sqe = submit_io(s, params.fd, params.page_size, offsets[submitted], params.read_or_write == "read", io, buffers[buffer_id], buffer_id, submitted);
+            sqe->ioprio = params.ioprio;
+            io->prep_time = current_time;
+            io->in_flight = submitted - stats.io_completed + 1;
+            if (params.latency_breakdown)
+            {
+                batch.push_back(io);
+            }
             to_submit++;
             submitted++;
+
+            if (flush_after)
+            {
+                writes_since_flush = 0;
+                if (params.link_flush)
+                {
+                    sqe->flags |= IOSQE_IO_LINK;
+                    struct io_data *flush = &flush_pool[flushes_submitted % flush_pool.size()];
+                    submit_flush(s, params.fd, params.flush_datasync, flush);
+                    flush->prep_time = current_time;
+                    flushes_submitted++;
+                    to_submit++;
+                }
+                else
+                {
+                    flush_pending = true;
+                }
+            }
+            else if (params.flush_interval)
+            {
+                writes_since_flush++;
+            }
+        }
+
+        if (to_submit == 0 && submitted == stats.io_completed && flushes_submitted == stats.flushes_completed)
+        {
+            if (pipeline && pipeline->held() > 0)
+            {
+                std::this_thread::yield(); // every buffer is with the compute stage
+                continue;
+            }
+            // rate limited with nothing in flight: sleep until the next I/O is due
+            replay_wait_until(std::min<uint64_t>(rate_due_time(params, stats.start_time, submitted),
+                                                 stats.start_time + params.duration * 1e9));
+            continue;
         }
 
-        int ret = io_uring_enter(s->ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL);
+        int ret;
+        if (params.latency_breakdown)
+        {
+            // submit and wait in separate calls so the submit side can be timed on its own
+            ret = io_uring_enter(s->ring_fd, to_submit, 0, 0, NULL);
+            uint64_t submit_time = get_current_time_ns();
+            for (auto io : batch)
+            {
+                io->submit_time = submit_time;
+            }
+            batch.clear();
+
+            if (ret >= 0)
+            {
+                ret = submit_and_wait(s, 0, params);
+            }
+        }
+        else
+        {
+            ret = submit_and_wait(s, to_submit, params);
+        }
         if (ret < 0)
         {
             throw std::runtime_error("io_uring_enter failed: " + std::string(strerror(-ret)));
         }
         to_submit = 0;
 
-        reap_cqes(s, stats.io_completed, is_buffer_free);
+        reap_cqes(s, stats, is_buffer_free, trace, params.latency_breakdown, params.verify, pipeline);
     }
 
     stats.end_time = get_current_time_ns();
 
+    // Let the I/O still in flight finish without counting it: the kernel writes into the
+    // buffers until then, and --verify reads the written pages back afterwards
+    uint64_t pending = (submitted - stats.io_completed) + (flushes_submitted - stats.flushes_completed);
+    thread_stats drained;
+    while (drained.io_completed + drained.flushes_completed < pending)
+    {
+        if (io_uring_enter(s->ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL) < 0)
+        {
+            break;
+        }
+        reap_cqes(s, drained, is_buffer_free);
+    }
+    if (pipeline)
+    {
+        pipeline_drain(pipeline, is_buffer_free);
+    }
+
     for (int i = 0; i < params.queue_depth; i++)
     {
         free(buffers[i]);
@@ -230,14 +518,104 @@ void time_benchmark_thread_iou(benchmark_params &params, thread_stats &stats, ui
     delete[] is_buffer_free;
     delete[] io_data_pool;
 
-    munmap(s->sq_ptr, s->sring_sz);
-    if (s->cq_ptr && s->cq_ptr != s->sq_ptr)
+    app_teardown_uring(s);
+
+    delete s;
+}
+
+void replay_benchmark_thread_iou(benchmark_params &params, thread_stats &stats, uint64_t thread_id)
+{
+    pin_thread(params.first_cpu + thread_id);
+
+    replay_trace *replay = params.replay;
+    trace_ring *trace = get_trace_ring(params, thread_id);
+
+    struct submitter *s = new submitter();
+
+    if (app_setup_uring(s, params.queue_depth, params.wq_fd))
     {
-        munmap(s->cq_ptr, s->cring_sz);
+        throw std::runtime_error("Error setting up io_uring");
     }
-    munmap(s->sqes, s->sqes_sz);
-    close(s->ring_fd);
 
+    char **buffers = new char *[params.queue_depth];
+    bool *is_buffer_free = new bool[params.queue_depth];
+    struct io_data **io_data_pool = new struct io_data *[params.queue_depth];
+    for (int i = 0; i < params.queue_depth; i++)
+    {
+        if (posix_memalign((void **)&buffers[i], params.page_size, replay->max_size))
+        {
+            throw std::runtime_error("posix_memalign failed");
+        }
+        is_buffer_free[i] = true;
+        io_data_pool[i] = new io_data();
+    }
+
+    uint64_t next = thread_id, submitted = 0, to_submit = 0;
+
+    stats.start_time = get_current_time_ns();
+
+    while (next < replay->entries.size() || submitted > stats.io_completed)
+    {
+        uint64_t current_time = get_current_time_ns();
+
+        while (next < replay->entries.size() && (submitted - stats.io_completed) < params.queue_depth)
+        {
+            const replay_entry &entry = replay->entries[next];
+            uint64_t deadline = replay_deadline(replay, entry);
+            if (deadline > current_time)
+            {
+                break;
+            }
+
+            uint32_t buffer_id = acquire_buffer(is_buffer_free, params.queue_depth);
+            if (buffer_id == -1)
+            {
+                break;
+            }
+
+            struct io_data *io = io_data_pool[buffer_id];
+            struct io_uring_sqe *sqe = submit_io(s, params.fd, entry.size, entry.offset, entry.op == TRACE_OP_READ, io, buffers[buffer_id], buffer_id, submitted);
+            sqe->ioprio = params.ioprio;
+            io->prep_time = current_time;
+            io->in_flight = submitted - stats.io_completed + 1;
+            replay_record_lag(stats, current_time, deadline);
+
+            to_submit++;
+            submitted++;
+            next += params.threads;
+        }
+
+        if (submitted == stats.io_completed)
+        {
+            // nothing in flight: sleep until the next request is due
+            replay_wait_until(replay_deadline(replay, replay->entries[next]));
+            continue;
+        }
+
+        // while a future request is pending, do not block past its deadline
+        bool pending = next < replay->entries.size() && replay->speed > 0;
+        int ret = io_uring_enter(s->ring_fd, to_submit, pending ? 0 : 1, IORING_ENTER_GETEVENTS, NULL);
+        if (ret < 0)
+        {
+            throw std::runtime_error("io_uring_enter failed: " + std::string(strerror(-ret)));
+        }
+        to_submit = 0;
+
+        reap_cqes(s, stats, is_buffer_free, trace);
+    }
+
+    stats.end_time = get_current_time_ns();
+
+    for (int i = 0; i < params.queue_depth; i++)
+    {
+        free(buffers[i]);
+        delete io_data_pool[i];
+    }
+    delete[] buffers;
+    delete[] is_buffer_free;
+    delete[] io_data_pool;
+
+    app_teardown_uring(s);
 
     delete s;
-}
\ No newline at end of file
+}
@@ -0,0 +1,458 @@
+#include "jobfile.h"
+#include "sync.h"
+#include "async.h"
+#include "iou.h"
+#include "coro.h"
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <sys/resource.h>
+#include <utility>
+
+// Options that make a run something other than a plain time-based measurement
+static const std::vector<std::string> unsupported_keys = {
+    "jobs", "trace", "replay", "replay_speed", "precondition", "workload", "find-max-iops", "slo", "size_sweep", "outliers", "verify",
+    "pipeline", "compute_threads", "attach_wq", "submitters", "thread_sweep", "repeat",
+    "json", "compare",
+};
+
+struct job_section
+{
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> options;
+};
+
+static std::string trim(const std::string &text)
+{
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+    {
+        return "";
+    }
+    return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+static void job_file_error(const std::string &path, uint64_t line_number, const std::string &message)
+{
+    std::cerr << "Error: " << path << ":" << line_number << ": " << message << "\n";
+    exit(1);
+}
+
+static std::vector<job_section> parse_job_file(const std::string &path, job_section &global)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Error: Cannot open job file " << path << ": " << strerror(errno) << "\n";
+        exit(1);
+    }
+
+    std::vector<job_section> sections;
+    job_section *current = nullptr;
+    std::string line;
+    uint64_t line_number = 0;
+
+    while (std::getline(file, line))
+    {
+        line_number++;
+        line = trim(line.substr(0, line.find_first_of("#;")));
+        if (line.empty())
+        {
+            continue;
+        }
+
+        if (line.front() == '[')
+        {
+            std::string name = trim(line.substr(1, line.size() - 2));
+            if (line.back() != ']' || name.empty())
+            {
+                job_file_error(path, line_number, "invalid section header");
+            }
+            if (name == "global")
+            {
+                current = &global;
+                continue;
+            }
+            if (std::any_of(sections.begin(), sections.end(), [&](const job_section &s) { return s.name == name; }))
+            {
+                job_file_error(path, line_number, "duplicate job '" + name + "'");
+            }
+            sections.push_back({name, {}});
+            current = &sections.back();
+            continue;
+        }
+
+        if (!current)
+        {
+            job_file_error(path, line_number, "option outside of a [job] section");
+        }
+
+        size_t equals = line.find('=');
+        std::string key = trim(line.substr(0, equals));
+        std::string value = (equals == std::string::npos) ? "" : trim(line.substr(equals + 1));
+        if (std::find(unsupported_keys.begin(), unsupported_keys.end(), key) != unsupported_keys.end())
+        {
+            job_file_error(path, line_number, "'" + key + "' is not supported in job files");
+        }
+        current->options.push_back({key, value});
+    }
+
+    if (sections.empty())
+    {
+        std::cerr << "Error: " << path << " defines no jobs.\n";
+        exit(1);
+    }
+    return sections;
+}
+
+job_file load_job_file(const std::string &path, bool skip_confirmation)
+{
+    job_section global = {"global", {}};
+    std::vector<job_section> sections = parse_job_file(path, global);
+
+    job_file jf;
+    uint64_t next_cpu = 0;
+
+    for (const auto &section : sections)
+    {
+        auto j = std::make_unique<job>();
+        j->name = section.name;
+
+        // the job's command line: [global] first, so the job's own keys win
+        std::vector<std::string> args = {"io_benchmark", "--time"};
+        if (skip_confirmation)
+        {
+            args.push_back("-y");
+        }
+        for (const job_section *options_of : {&std::as_const(global), &section})
+        {
+            for (const auto &[key, value] : options_of->options)
+            {
+                // keys of the job runner itself, not command line options
+                if (key == "background" || key == "ioprio_sweep")
+                {
+                    if ((key == "background") != (options_of == &section))
+                    {
+                        std::cerr << "Error: " << path << ": '" << key << "' belongs in "
+                                  << (key == "background" ? "a job section" : "[global]") << ".\n";
+                        exit(1);
+                    }
+                    j->background = j->background || key == "background";
+                    continue;
+                }
+                args.push_back((value.empty() || value == "true") ? "--" + key : "--" + key + "=" + value);
+            }
+        }
+
+        std::vector<char *> argv;
+        for (auto &arg : args)
+        {
+            argv.push_back(arg.data());
+        }
+        argv.push_back(nullptr);
+
+        std::cout << "Job " << section.name << (j->background ? " (background):" : ":") << std::endl;
+        optind = 0; // full getopt reinitialisation for every job
+
+        j->params = parse_arguments(argv.size() - 1, argv.data());
+        j->params.first_cpu = next_cpu;
+        next_cpu += j->params.threads;
+        jf.jobs.push_back(std::move(j));
+    }
+
+    for (const auto &[key, value] : global.options)
+    {
+        if (key != "ioprio_sweep")
+        {
+            continue;
+        }
+        std::stringstream list(value);
+        std::string spec;
+        while (std::getline(list, spec, ','))
+        {
+            try
+            {
+                parse_ioprio(spec);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Error: Invalid ioprio_sweep entry: " << e.what() << "\n";
+                exit(1);
+            }
+            jf.ioprio_sweep.push_back(spec);
+        }
+    }
+
+    bool has_background = std::any_of(jf.jobs.begin(), jf.jobs.end(), [](const auto &j) { return j->background; });
+    bool has_foreground = std::any_of(jf.jobs.begin(), jf.jobs.end(), [](const auto &j) { return !j->background; });
+    if (has_background && !has_foreground)
+    {
+        std::cerr << "Error: " << path << " has background jobs but nothing to measure in the foreground.\n";
+        exit(1);
+    }
+    if (!jf.ioprio_sweep.empty() && !has_background)
+    {
+        std::cerr << "Error: ioprio_sweep needs at least one background job.\n";
+        exit(1);
+    }
+
+    return jf;
+}
+
+static std::thread start_worker(benchmark_params &params, thread_stats &stats, uint64_t thread_id)
+{
+    if (params.engine == "sync")
+    {
+        return std::thread(time_benchmark_thread_sync, std::ref(params), std::ref(stats), thread_id);
+    }
+    else if (params.engine == "liburing")
+    {
+        return std::thread(time_benchmark_thread_async, std::ref(params), std::ref(stats), thread_id);
+    }
+    else if (params.engine == "coro")
+    {
+        return std::thread(time_benchmark_thread_coro, std::ref(params), std::ref(stats), thread_id);
+    }
+    return std::thread(time_benchmark_thread_iou, std::ref(params), std::ref(stats), thread_id);
+}
+
+static uint64_t job_io_completed(const job &j)
+{
+    uint64_t total = 0;
+    for (const auto &stats : j.stats)
+    {
+        total += stats.io_completed;
+    }
+    return total;
+}
+
+static void print_job_stats_thread(const std::vector<job *> &jobs, const std::atomic<bool> &running)
+{
+    static constexpr uint64_t interval_ms = 1000;
+    std::vector<uint64_t> last_io_count(jobs.size(), 0);
+    uint64_t start_time = get_current_time_ns();
+
+    while (running)
+    {
+        // short sleeps so the thread notices the end of the run quickly
+        for (uint64_t slept = 0; slept < interval_ms && running; slept += 100)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        if (!running)
+        {
+            break;
+        }
+
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2);
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            uint64_t io_completed = job_io_completed(*jobs[i]);
+            uint64_t io_diff = io_completed - last_io_count[i];
+            last_io_count[i] = io_completed;
+
+            out << "Job " << jobs[i]->name << ": Elapsed Time: " << (get_current_time_ns() - start_time) / 1e9 << "s"
+                << ", IOPS: " << io_diff * 1000 / interval_ms
+                << ", Bandwidth: " << double(io_diff * jobs[i]->params.page_size) / (interval_ms * KILO) << " MB/s\n";
+        }
+        out << "-----\n";
+        std::cout << out.str() << std::flush;
+    }
+}
+
+// One job in one round
+struct job_result
+{
+    bool ran = false;
+    uint64_t io_completed = 0;
+    double seconds = 0;
+    double data_size_MB = 0;
+    latency_histogram latency;
+};
+
+static std::vector<job_result> run_round(std::vector<std::unique_ptr<job>> &jobs, bool with_background)
+{
+    std::vector<job *> active;
+    for (auto &j : jobs)
+    {
+        j->stats = std::vector<thread_stats>(j->params.threads);
+        if (with_background || !j->background)
+        {
+            active.push_back(j.get());
+        }
+    }
+
+    std::atomic<bool> running{true};
+    std::thread stats_thread(print_job_stats_thread, std::cref(active), std::cref(running));
+
+    std::vector<std::thread> workers;
+    for (job *j : active)
+    {
+        for (uint64_t i = 0; i < j->params.threads; i++)
+        {
+            workers.push_back(start_worker(j->params, j->stats[i], i));
+        }
+    }
+    for (auto &t : workers)
+    {
+        t.join();
+    }
+
+    running = false;
+    stats_thread.join();
+
+    std::vector<job_result> results(jobs.size());
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        const job &j = *jobs[i];
+        if (std::find(active.begin(), active.end(), &j) == active.end())
+        {
+            continue;
+        }
+
+        job_result &r = results[i];
+        r.ran = true;
+        for (const auto &stats : j.stats)
+        {
+            r.latency.merge(stats.latency);
+            r.seconds = std::max(r.seconds, (stats.end_time - stats.start_time) / 1e9);
+        }
+        r.io_completed = job_io_completed(j);
+        r.data_size_MB = double(r.io_completed) * j.params.page_size / (KILO * KILO);
+
+        const benchmark_params &p = j.params;
+        std::cout << "Job " << j.name << ": " << p.engine << " " << p.seq_or_rand << " " << p.read_or_write
+                  << ", page size " << p.page_size << ", " << p.threads << " threads x QD " << p.queue_depth;
+        if (p.rate_iops)
+        {
+            std::cout << ", rate " << p.rate_iops << " IOPS";
+        }
+        if (!p.ioprio_spec.empty())
+        {
+            std::cout << ", ioprio " << p.ioprio_spec;
+        }
+        std::cout << ", " << p.location << std::endl;
+        print_latency_summary("Job " + j.name + " Latency", r.latency);
+        std::cout << "Job " << j.name << ": I/O Completed: " << r.io_completed
+                  << ", Throughput: " << (r.seconds > 0 ? r.io_completed / r.seconds : 0) << " IOPS"
+                  << ", Bandwidth: " << (r.seconds > 0 ? r.data_size_MB / r.seconds : 0) << " MB/s" << std::endl;
+    }
+    return results;
+}
+
+// Foreground latency of every round next to the round without background load
+static void print_priority_comparison(const std::vector<std::unique_ptr<job>> &jobs,
+                                      const std::vector<std::pair<std::string, std::vector<job_result>>> &rounds)
+{
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(2);
+    report << std::left << std::setw(16) << "Job" << std::setw(28) << "Round" << std::right
+           << std::setw(14) << "IOPS" << std::setw(12) << "p50 us" << std::setw(12) << "p99 us"
+           << std::setw(12) << "p99.9 us" << std::setw(14) << "p99 vs alone" << "\n";
+
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        if (jobs[i]->background)
+        {
+            continue;
+        }
+        double alone_p99 = rounds.front().second[i].latency.percentile(99);
+        for (const auto &[label, results] : rounds)
+        {
+            const job_result &r = results[i];
+            double p99 = r.latency.percentile(99);
+            std::ostringstream ratio;
+            ratio << std::fixed << std::setprecision(2) << (alone_p99 > 0 ? p99 / alone_p99 : 0) << "x";
+
+            report << std::left << std::setw(16) << jobs[i]->name << std::setw(28) << label << std::right
+                   << std::setw(14) << (r.seconds > 0 ? r.io_completed / r.seconds : 0)
+                   << std::setw(12) << r.latency.percentile(50) / 1e3
+                   << std::setw(12) << p99 / 1e3
+                   << std::setw(12) << r.latency.percentile(99.9) / 1e3
+                   << std::setw(14) << ratio.str() << "\n";
+        }
+    }
+
+    std::cout << "Priority Comparison (foreground jobs):\n" << report.str();
+}
+
+void run_jobs(job_file &jf)
+{
+    std::vector<std::unique_ptr<job>> &jobs = jf.jobs;
+    bool has_background = std::any_of(jobs.begin(), jobs.end(), [](const auto &j) { return j->background; });
+
+    struct rusage usage_start, usage_end;
+    getrusage(RUSAGE_SELF, &usage_start);
+
+    std::vector<std::pair<std::string, std::vector<job_result>>> rounds;
+    if (!has_background)
+    {
+        rounds.push_back({"", run_round(jobs, true)});
+    }
+    else
+    {
+        std::cout << "Round: foreground alone" << std::endl;
+        rounds.push_back({"alone", run_round(jobs, false)});
+
+        std::vector<std::string> settings = jf.ioprio_sweep.empty() ? std::vector<std::string>{""} : jf.ioprio_sweep;
+        for (const auto &setting : settings)
+        {
+            std::string label = "with background";
+            if (!setting.empty())
+            {
+                for (auto &j : jobs)
+                {
+                    if (j->background)
+                    {
+                        j->params.ioprio_spec = setting;
+                        j->params.ioprio = parse_ioprio(setting);
+                    }
+                }
+                label = "background ioprio " + setting;
+            }
+            std::cout << "Round: " << label << std::endl;
+            rounds.push_back({label, run_round(jobs, true)});
+        }
+    }
+
+    getrusage(RUSAGE_SELF, &usage_end);
+
+    if (has_background)
+    {
+        print_priority_comparison(jobs, rounds);
+    }
+
+    uint64_t total_io_completed = 0;
+    double total_data_size = 0, total_time = 0;
+    for (const auto &round : rounds)
+    {
+        double round_time = 0;
+        for (const auto &r : round.second)
+        {
+            total_io_completed += r.io_completed;
+            total_data_size += r.data_size_MB;
+            round_time = std::max(round_time, r.seconds);
+        }
+        total_time += round_time;
+    }
+
+    double user_seconds = (usage_end.ru_utime.tv_sec - usage_start.ru_utime.tv_sec) +
+                          (usage_end.ru_utime.tv_usec - usage_start.ru_utime.tv_usec) / 1e6;
+    double system_seconds = (usage_end.ru_stime.tv_sec - usage_start.ru_stime.tv_sec) +
+                            (usage_end.ru_stime.tv_usec - usage_start.ru_stime.tv_usec) / 1e6;
+    std::cout << "CPU: user " << user_seconds << " s, system " << system_seconds << " s, "
+              << (total_io_completed ? (user_seconds + system_seconds) * 1e6 / total_io_completed : 0) << " us per I/O, "
+              << (user_seconds + system_seconds) / total_time << " cores" << std::endl;
+
+    std::cout << "Total I/O Completed: " << total_io_completed
+              << "\nTotal Data Size: " << total_data_size << " MB"
+              << "\nTotal Time: " << total_time << " seconds"
+              << "\nThroughput: " << total_io_completed / total_time << " IOPS"
+              << "\nBandwidth: " << total_data_size / total_time << " MB/s" << std::endl;
+
+    for (auto &j : jobs)
+    {
+        close(j->params.fd);
+    }
+}
@@ -2,6 +2,18 @@
 #include "sync.h"
 #include "async.h"
 #include "iou.h"
+#include "trace.h"
+#include "replay.h"
+#include "precondition.h"
+#include "wal.h"
+#include "tuner.h"
+#include "coro.h"
+#include "jobfile.h"
+#include "verify.h"
+#include "pipeline.h"
+#include "ringshare.h"
+#include <sys/resource.h>
+#include <iomanip>
 
 bool print = false;
 
@@ -34,6 +46,9 @@ void print_stats_thread(benchmark_params &params,
     }
 
     std::vector<uint64_t> last_io_count(params.threads, 0); // Store last recorded I/O count
+    std::vector<uint64_t> last_bytes_count(params.threads, 0);
+    // replayed requests and WAL records have their own sizes, as in the final report
+    bool sized_requests = params.replay || params.workload == "wal";
 
 while (print) 
 {
@@ -52,8 +67,11 @@ while (print)
         uint64_t io_diff = stats.io_completed - last_io_count[i];
         last_io_count[i] = stats.io_completed; // Update last recorded value
 
+        uint64_t bytes_diff = sized_requests ? stats.bytes_completed - last_bytes_count[i] : io_diff * params.page_size;
+        last_bytes_count[i] = stats.bytes_completed;
+
         // Calculate bandwidth for this interval (MB/s)
-        double bandwidth = static_cast<double>(io_diff * params.page_size) / (interval.count() / 1000 * KILO * KILO);
+        double bandwidth = static_cast<double>(bytes_diff) / (interval.count() / 1000 * KILO * KILO);
 
 
         bandwidth_sum += bandwidth;
@@ -88,7 +106,74 @@ int main(int argc, char *argv[])
 {
     benchmark_params params = parse_arguments(argc, argv);
 
+    if (!params.job_file.empty())
+    {
+        job_file jf = load_job_file(params.job_file, params.skip_confirmation);
+        run_jobs(jf);
+        return EXIT_SUCCESS;
+    }
+
+    // bring the drive to steady state before anything is measured
+    if (!params.precondition.empty())
+    {
+        run_precondition(params);
+    }
+
+    if (params.attach_wq)
+    {
+        open_wq_anchor(params);
+    }
+
+    if (!params.thread_sweep.empty())
+    {
+        run_thread_sweep(params);
+        close(params.fd);
+        return EXIT_SUCCESS;
+    }
+
+    if (params.repeat > 1)
+    {
+        bool regressed = run_repeat(params);
+        close(params.fd);
+        return regressed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (!params.size_sweep.empty())
+    {
+        run_size_sweep(params);
+        close(params.fd);
+        return EXIT_SUCCESS;
+    }
+
+    if (params.find_max_iops)
+    {
+        run_find_max_iops(params);
+        close(params.fd);
+        return EXIT_SUCCESS;
+    }
+
     std::vector<thread_stats> thread_stats_list(params.threads);
+    for (uint64_t i = 0; i < params.threads && params.outliers; i++)
+    {
+        thread_stats_list[i].outliers.init(params.outliers, i);
+    }
+
+    if (!params.trace_path.empty())
+    {
+        params.trace = trace_open(params.trace_path, params.threads);
+    }
+    if (params.verify != verify_algorithm::none && params.read_or_write == "write")
+    {
+        verify_track_writes(params);
+    }
+    if (!params.pipeline_spec.empty())
+    {
+        params.pipeline = pipeline_start(params);
+    }
+    if (params.submitters > 1)
+    {
+        shared_rings_start(params);
+    }
     std::vector<std::thread> threads;
 
     // launch a thread that constantly prints statistics every second
@@ -96,67 +181,134 @@ int main(int argc, char *argv[])
     std::thread stats_thread(print_stats_thread, std::ref(params), std::ref(thread_stats_list), std::chrono::milliseconds(1000), PrintMode::Both);
 
 
-    for (uint64_t i = 0; i < params.threads; ++i)
+    if (params.replay)
     {
-        if (params.engine == "sync")
+        // common start so all threads follow the same schedule
+        params.replay->start_ns = get_current_time_ns();
+    }
+
+    // process CPU time covers the workers plus any io-wq threads the kernel runs for them
+    struct rusage usage_start, usage_end;
+    getrusage(RUSAGE_SELF, &usage_start);
+
+    wal_summary wal;
+    if (params.workload == "wal")
+    {
+        // producers and the committer run inside; the engine only drives the committer's writes
+        wal = run_wal_workload(params, thread_stats_list);
+    }
+    else
+    {
+        for (uint64_t i = 0; i < params.threads; ++i)
         {
-            if (params.time_based)
+            if (params.engine == "sync")
             {
-                threads.push_back(std::thread(time_benchmark_thread_sync, std::ref(params), std::ref(thread_stats_list[i]), i));
+                if (params.replay)
+                {
+                    threads.push_back(std::thread(replay_benchmark_thread_sync, std::ref(params), std::ref(thread_stats_list[i]), i));
+                }
+                else if (params.time_based)
+                {
+                    threads.push_back(std::thread(time_benchmark_thread_sync, std::ref(params), std::ref(thread_stats_list[i]), i));
+                }
+                else
+                {
+                    threads.push_back(std::thread(io_benchmark_thread_sync, std::ref(params), std::ref(thread_stats_list[i]), i));
+                }
             }
-            else
+            else if (params.submitters > 1)
             {
-                threads.push_back(std::thread(io_benchmark_thread_sync, std::ref(params), std::ref(thread_stats_list[i]), i));
+                threads.push_back(std::thread(time_benchmark_thread_shared, std::ref(params), std::ref(thread_stats_list[i]), i));
             }
-        }
-        else if (params.engine == "liburing")
-        {
-            if (params.time_based)
+            else if (params.engine == "liburing")
             {
-                threads.push_back(std::thread(time_benchmark_thread_async, std::ref(params), std::ref(thread_stats_list[i]), i));
+                if (params.replay)
+                {
+                    threads.push_back(std::thread(replay_benchmark_thread_async, std::ref(params), std::ref(thread_stats_list[i]), i));
+                }
+                else if (params.time_based)
+                {
+                    threads.push_back(std::thread(time_benchmark_thread_async, std::ref(params), std::ref(thread_stats_list[i]), i));
+                }
+                else
+                {
+                    threads.push_back(std::thread(io_benchmark_thread_async, std::ref(params), std::ref(thread_stats_list[i]), i));
+                }
             }
-            else
+            else if (params.engine == "io_uring")
             {
-                threads.push_back(std::thread(io_benchmark_thread_async, std::ref(params), std::ref(thread_stats_list[i]), i));
+                if (params.replay)
+                {
+                    threads.push_back(std::thread(replay_benchmark_thread_iou, std::ref(params), std::ref(thread_stats_list[i]), i));
+                }
+                else if (params.time_based)
+                {
+                    threads.push_back(std::thread(time_benchmark_thread_iou, std::ref(params), std::ref(thread_stats_list[i]), i));
+                }
+                else
+                {
+                    threads.push_back(std::thread(io_benchmark_thread_iou, std::ref(params), std::ref(thread_stats_list[i]), i));
+                }
             }
-        }
-        else if (params.engine == "io_uring")
-        {
-            if (params.time_based)
+            else if (params.engine == "coro")
             {
-                threads.push_back(std::thread(time_benchmark_thread_iou, std::ref(params), std::ref(thread_stats_list[i]), i));
+                threads.push_back(std::thread(time_benchmark_thread_coro, std::ref(params), std::ref(thread_stats_list[i]), i));
             }
             else
             {
-                threads.push_back(std::thread(io_benchmark_thread_iou, std::ref(params), std::ref(thread_stats_list[i]), i));
+                std::cerr << "Invalid engine specified\n";
+                exit(EXIT_FAILURE);
             }
         }
-        else
+
+        // wait for all threads to complete
+        for (auto &t : threads)
         {
-            std::cerr << "Invalid engine specified\n";
-            exit(EXIT_FAILURE);
+            t.join();
         }
     }
 
-    // wait for all threads to complete
-    for (auto &t : threads)
+    if (params.pipeline)
     {
-        t.join();
+        // every I/O thread got its buffers back, so the workers have nothing left to do
+        pipeline_stop(params.pipeline);
     }
-    
+
+    getrusage(RUSAGE_SELF, &usage_end);
+
     print = false;
     // clear the stats buffer
     std::cout << "\r" << std::string(params.stats_buffer.str().length(), ' ') << "\r" << std::flush;
 
     stats_thread.join();
 
+    if (params.trace)
+    {
+        trace_close(params.trace);
+        params.trace = nullptr;
+    }
+
+    // read back everything the run wrote; not part of the measurement
+    verify_pass_result verify_pass;
+    if (params.written_pages)
+    {
+        verify_pass = run_verify_pass(params);
+    }
+
     // calculate total statistics
     uint64_t total_io_completed = 0;
     double total_time = 0;
+    thread_stats totals;
 
     for (const auto &stats : thread_stats_list)
     {
         total_io_completed += stats.io_completed;
+        totals.latency.merge(stats.latency);
+        totals.submit_delay.merge(stats.submit_delay);
+        totals.device_time.merge(stats.device_time);
+        totals.reap_lag.merge(stats.reap_lag);
+        totals.flush_latency.merge(stats.flush_latency);
+        totals.flushes_completed += stats.flushes_completed;
         double time_elapsed = (stats.end_time - stats.start_time) / 1e9;
 
         total_time = std::max(total_time, time_elapsed);
@@ -165,8 +317,99 @@ int main(int argc, char *argv[])
     double throughput = double(total_io_completed) / total_time;
 
     double total_data_size = total_io_completed * params.page_size;
+    if (params.replay || params.workload == "wal")
+    {
+        // replayed requests and WAL records have their own sizes
+        total_data_size = 0;
+        for (const auto &stats : thread_stats_list)
+        {
+            total_data_size += stats.bytes_completed;
+        }
+    }
     double total_data_size_MB = total_data_size / (KILO * KILO);
 
+    // Extra reports go first: scripts/benchmark.py parses the last lines of the output
+    std::string latency_name = params.workload == "wal"                 ? "Commit Latency"
+                               : params.read_or_write == "trim"         ? "Trim Latency"
+                               : params.read_or_write == "write_zeroes" ? "Write Zeroes Latency"
+                                                                        : "Latency";
+    print_latency_summary(latency_name, totals.latency);
+    if (params.latency_breakdown)
+    {
+        print_latency_summary("Submit Delay", totals.submit_delay);
+        print_latency_summary("Device Time", totals.device_time);
+        print_latency_summary("Reap Lag", totals.reap_lag);
+        print_latency_histograms({"Submit Delay", "Device Time", "Reap Lag", "End to End"},
+                                 {&totals.submit_delay, &totals.device_time, &totals.reap_lag, &totals.latency});
+    }
+
+    if (params.flush_interval)
+    {
+        std::cout << "Flushes Completed: " << totals.flushes_completed << std::endl;
+        print_latency_summary("Flush Latency", totals.flush_latency);
+    }
+
+    if (params.engine == "coro")
+    {
+        print_stream_summary(params, thread_stats_list, total_time);
+    }
+
+    if (params.workload == "wal")
+    {
+        print_wal_summary(params, wal, thread_stats_list);
+    }
+
+    if (params.replay)
+    {
+        print_replay_summary(params.replay, thread_stats_list);
+        delete params.replay;
+    }
+
+    if (params.outliers)
+    {
+        print_outlier_report(params, thread_stats_list);
+    }
+
+    uint64_t verify_errors = 0;
+    if (params.verify != verify_algorithm::none)
+    {
+        verify_errors = print_verify_summary(params, thread_stats_list, verify_pass);
+    }
+
+    if (params.pipeline)
+    {
+        print_pipeline_summary(params.pipeline, params, thread_stats_list, total_time);
+        params.pipeline = nullptr;
+    }
+
+    if (params.shared_rings)
+    {
+        print_shared_ring_summary(params);
+        shared_rings_stop(params);
+    }
+
+    if (params.coalesce > 1)
+    {
+        uint64_t requests = 0;
+        for (const auto &stats : thread_stats_list)
+        {
+            requests += stats.coalesced_requests;
+        }
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2)
+            << "Coalescing: " << requests / total_time << " requests/s for " << throughput << " I/Os/s, "
+            << (requests ? double(total_io_completed) / requests : 0) << " I/Os per request (up to " << params.coalesce << ")\n";
+        std::cout << out.str() << std::flush;
+    }
+
+    double user_seconds = (usage_end.ru_utime.tv_sec - usage_start.ru_utime.tv_sec) +
+                          (usage_end.ru_utime.tv_usec - usage_start.ru_utime.tv_usec) / 1e6;
+    double system_seconds = (usage_end.ru_stime.tv_sec - usage_start.ru_stime.tv_sec) +
+                            (usage_end.ru_stime.tv_usec - usage_start.ru_stime.tv_usec) / 1e6;
+    std::cout << "CPU: user " << user_seconds << " s, system " << system_seconds << " s, "
+              << (total_io_completed ? (user_seconds + system_seconds) * 1e6 / total_io_completed : 0) << " us per I/O, "
+              << (user_seconds + system_seconds) / total_time << " cores" << std::endl;
+
     std::cout << "Total I/O Completed: " << total_io_completed
               << "\nTotal Data Size: " << total_data_size_MB << " MB"
               << "\nTotal Time: " << total_time << " seconds"
@@ -175,5 +418,5 @@ int main(int argc, char *argv[])
 
 
     close(params.fd);
-    return EXIT_SUCCESS;
+    return verify_errors ? EXIT_FAILURE : EXIT_SUCCESS;
 }
\ No newline at end of file
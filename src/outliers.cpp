@@ -0,0 +1,170 @@
+#include "outliers.h"
+#include "config.h"
+#include "trace.h"
+#include <iomanip>
+
+// Sorts slowest first; as a heap comparator it keeps the fastest record on top
+static bool slower_first(const outlier_record &a, const outlier_record &b)
+{
+    return a.latency_ns > b.latency_ns;
+}
+
+void outlier_heap::init(uint64_t k, uint16_t thread)
+{
+    capacity = k;
+    threshold = k ? 0 : UINT64_MAX;
+    thread_id = thread;
+    records.clear();
+    records.reserve(k);
+}
+
+void outlier_heap::push(const outlier_record &record)
+{
+    if (records.size() < capacity)
+    {
+        records.push_back(record);
+        std::push_heap(records.begin(), records.end(), slower_first);
+    }
+    else
+    {
+        std::pop_heap(records.begin(), records.end(), slower_first);
+        records.back() = record;
+        std::push_heap(records.begin(), records.end(), slower_first);
+    }
+
+    if (records.size() == capacity)
+    {
+        threshold = records.front().latency_ns;
+    }
+}
+
+static const char *op_name(uint8_t op)
+{
+    switch (op)
+    {
+    case TRACE_OP_WRITE:
+        return "write";
+    case TRACE_OP_FLUSH:
+        return "flush";
+    case TRACE_OP_TRIM:
+        return "trim";
+    case TRACE_OP_WRITE_ZEROES:
+        return "zero";
+    default:
+        return "read";
+    }
+}
+
+// get_current_time_ns() is CLOCK_MONOTONIC_RAW; shift it onto the wall clock for the report
+static std::string wall_clock(uint64_t monotonic_ns, int64_t wall_offset_ns)
+{
+    int64_t wall_ns = static_cast<int64_t>(monotonic_ns) + wall_offset_ns;
+    time_t seconds = wall_ns / 1000000000;
+    struct tm local;
+    localtime_r(&seconds, &local);
+
+    std::ostringstream text;
+    text << std::put_time(&local, "%Y-%m-%d %H:%M:%S") << "."
+         << std::setw(3) << std::setfill('0') << (wall_ns / 1000000) % 1000;
+    return text.str();
+}
+
+static void print_bar_chart(std::ostream &out, const std::vector<std::string> &labels, const std::vector<uint64_t> &counts)
+{
+    static constexpr uint64_t bar_width = 50;
+    uint64_t max_count = std::max<uint64_t>(1, *std::max_element(counts.begin(), counts.end()));
+    for (size_t i = 0; i < counts.size(); i++)
+    {
+        out << std::setw(26) << labels[i] << std::setw(10) << counts[i] << "  "
+            << std::string((counts[i] * bar_width + max_count - 1) / max_count, '#') << "\n";
+    }
+}
+
+void print_outlier_report(const benchmark_params &params, const std::vector<thread_stats> &thread_stats_list)
+{
+    static constexpr uint64_t listed = 20;
+    static constexpr uint64_t time_buckets = 20;
+    static constexpr uint64_t lba_buckets = 16;
+
+    std::vector<outlier_record> outliers;
+    uint64_t total_io = 0, run_start = UINT64_MAX, run_end = 0;
+    for (const auto &stats : thread_stats_list)
+    {
+        outliers.insert(outliers.end(), stats.outliers.records.begin(), stats.outliers.records.end());
+        total_io += stats.io_completed;
+        run_start = std::min(run_start, stats.start_time);
+        run_end = std::max(run_end, stats.end_time);
+    }
+    std::sort(outliers.begin(), outliers.end(), slower_first);
+    if (outliers.size() > params.outliers)
+    {
+        outliers.resize(params.outliers);
+    }
+    if (outliers.empty())
+    {
+        std::cout << "Outliers: none recorded" << std::endl;
+        return;
+    }
+
+    struct timespec realtime;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    int64_t wall_offset_ns = static_cast<int64_t>(realtime.tv_sec * 1000000000LL + realtime.tv_nsec) -
+                             static_cast<int64_t>(get_current_time_ns());
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << "Outliers: " << outliers.size() << " slowest of " << total_io << " I/Os (latency >= "
+        << outliers.back().latency_ns / 1e3 << " us)\n"
+        << std::setw(12) << "Latency us" << std::setw(10) << "Time s" << std::setw(25) << "Wall Clock"
+        << std::setw(8) << "Thread" << std::setw(7) << "Op" << std::setw(16) << "Offset"
+        << std::setw(10) << "Size" << std::setw(11) << "In Flight" << "\n";
+    for (uint64_t i = 0; i < std::min<uint64_t>(listed, outliers.size()); i++)
+    {
+        const outlier_record &r = outliers[i];
+        out << std::setw(12) << r.latency_ns / 1e3
+            << std::setw(10) << (r.submit_ns - run_start) / 1e9
+            << std::setw(25) << wall_clock(r.submit_ns, wall_offset_ns)
+            << std::setw(8) << r.thread_id << std::setw(7) << op_name(r.op)
+            << std::setw(16) << r.offset << std::setw(10) << r.size << std::setw(11) << r.in_flight << "\n";
+    }
+
+    // when in the run they were submitted: GC and other background work shows up as clusters
+    double run_seconds = std::max<uint64_t>(1, run_end - run_start) / 1e9;
+    double bucket_seconds = run_seconds / time_buckets;
+    std::vector<uint64_t> counts(time_buckets, 0);
+    std::vector<std::string> labels;
+    for (const auto &r : outliers)
+    {
+        counts[std::min<uint64_t>(time_buckets - 1, (r.submit_ns - run_start) / 1e9 / bucket_seconds)]++;
+    }
+    for (uint64_t i = 0; i < time_buckets; i++)
+    {
+        std::ostringstream label;
+        label << std::fixed << std::setprecision(2) << i * bucket_seconds << " - " << (i + 1) * bucket_seconds << " s";
+        labels.push_back(label.str());
+    }
+    out << "Outliers Over Time:\n";
+    print_bar_chart(out, labels, counts);
+
+    // where on the device: a slow LBA range shows up as one heavy bucket
+    uint64_t bucket_bytes = std::max<uint64_t>(params.page_size, (params.region_size + lba_buckets - 1) / lba_buckets);
+    counts.assign(lba_buckets, 0);
+    labels.clear();
+    for (const auto &r : outliers)
+    {
+        uint64_t relative = r.offset >= params.region_offset ? r.offset - params.region_offset : 0;
+        counts[std::min<uint64_t>(lba_buckets - 1, relative / bucket_bytes)]++;
+    }
+    uint64_t unit = bucket_bytes >= KIBI * KIBI * KIBI ? KIBI * KIBI * KIBI : bucket_bytes >= KIBI * KIBI ? KIBI * KIBI : KIBI;
+    std::string unit_name = unit == KIBI ? " KiB" : unit == KIBI * KIBI ? " MiB" : " GiB";
+    for (uint64_t i = 0; i < lba_buckets; i++)
+    {
+        std::ostringstream label;
+        label << std::fixed << std::setprecision(2) << double(params.region_offset + i * bucket_bytes) / unit << " - "
+              << double(params.region_offset + (i + 1) * bucket_bytes) / unit << unit_name;
+        labels.push_back(label.str());
+    }
+    out << "Outliers By Offset (" << double(bucket_bytes) / unit << unit_name << " buckets):\n";
+    print_bar_chart(out, labels, counts);
+    std::cout << out.str() << std::flush;
+}
@@ -0,0 +1,263 @@
+#include "pipeline.h"
+#include "verify.h"
+#include <iomanip>
+
+// Workers that find the queue empty spin this many times before yielding the CPU
+static constexpr uint64_t idle_spins_before_yield = 1000;
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+compute_stage parse_compute_stage(const std::string &spec, double &spin_ns_per_byte)
+{
+    spin_ns_per_byte = 0;
+    if (spec == "checksum")
+    {
+        return compute_stage::checksum;
+    }
+    if (spec == "memcpy")
+    {
+        return compute_stage::memcpy;
+    }
+    if (spec.rfind("spin:", 0) == 0)
+    {
+        const char *number = spec.c_str() + 5;
+        char *end = nullptr;
+        spin_ns_per_byte = strtod(number, &end);
+        if (end == number || *end != '\0' || spin_ns_per_byte < 0)
+        {
+            throw std::invalid_argument("spin needs a non-negative number of ns per byte");
+        }
+        return compute_stage::spin;
+    }
+    throw std::invalid_argument("unknown stage '" + spec + "' (use checksum, memcpy or spin:<ns per byte>)");
+}
+
+static void compute_worker(compute_pipeline *pipeline, uint64_t page_size, uint64_t cpu, uint64_t worker_id)
+{
+    pin_thread(cpu);
+    compute_worker_stats &stats = pipeline->workers[worker_id];
+
+    char *scratch = nullptr;
+    if (posix_memalign((void **)&scratch, page_size, page_size) != 0)
+    {
+        throw std::runtime_error("Error allocating buffer: " + std::string(strerror(errno)));
+    }
+
+    stats.start_time = get_current_time_ns();
+    uint64_t idle_spins = 0;
+    pipeline_item item;
+
+    while (true)
+    {
+        if (!pipeline->work.try_pop(item))
+        {
+            // the I/O threads drained their buffers before stopping was set, so the queue stays empty
+            if (pipeline->stopping.load(std::memory_order_acquire))
+            {
+                break;
+            }
+            if (++idle_spins < idle_spins_before_yield)
+            {
+                cpu_relax();
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+            continue;
+        }
+        idle_spins = 0;
+
+        uint64_t start = get_current_time_ns();
+        stats.queue_wait.record(start - item.completion_time);
+
+        switch (pipeline->stage)
+        {
+        case compute_stage::checksum:
+            stats.sink += crc32c(item.buffer, item.length);
+            break;
+        case compute_stage::memcpy:
+            memcpy(scratch, item.buffer, item.length);
+            stats.sink += scratch[item.length - 1];
+            break;
+        case compute_stage::spin:
+        {
+            uint64_t deadline = start + static_cast<uint64_t>(item.length * pipeline->spin_ns_per_byte);
+            while (get_current_time_ns() < deadline)
+            {
+            }
+            break;
+        }
+        }
+
+        uint64_t end = get_current_time_ns();
+        stats.busy_ns += end - start;
+        stats.buffers++;
+        stats.bytes += item.length;
+        stats.end_time = end;
+
+        // the return queue holds every buffer of the thread, so this never spins in practice
+        while (!item.port->returned->try_push(item.buffer_id))
+        {
+            cpu_relax();
+        }
+    }
+
+    free(scratch);
+}
+
+compute_pipeline *pipeline_start(const benchmark_params &params)
+{
+    compute_pipeline *pipeline = new compute_pipeline(params.threads * params.queue_depth);
+    pipeline->stage = parse_compute_stage(params.pipeline_spec, pipeline->spin_ns_per_byte);
+    pipeline->queue_depth = params.queue_depth;
+
+    for (uint64_t i = 0; i < params.threads; i++)
+    {
+        auto port = std::make_unique<pipeline_port>();
+        port->pipeline = pipeline;
+        port->thread_id = i;
+        port->returned = std::make_unique<mpmc_queue<uint32_t>>(params.queue_depth);
+        pipeline->ports.push_back(std::move(port));
+    }
+
+    pipeline->workers = std::vector<compute_worker_stats>(params.compute_threads);
+    for (uint64_t i = 0; i < params.compute_threads; i++)
+    {
+        // workers get the CPUs after the I/O threads
+        pipeline->threads.push_back(std::thread(compute_worker, pipeline, params.page_size,
+                                                params.first_cpu + params.threads + i, i));
+    }
+    return pipeline;
+}
+
+void pipeline_stop(compute_pipeline *pipeline)
+{
+    pipeline->stopping.store(true, std::memory_order_release);
+    for (auto &t : pipeline->threads)
+    {
+        t.join();
+    }
+}
+
+pipeline_port *get_pipeline_port(const benchmark_params &params, uint64_t thread_id)
+{
+    return params.pipeline ? params.pipeline->ports[thread_id].get() : nullptr;
+}
+
+void pipeline_hand_off(pipeline_port *port, uint32_t buffer_id, char *buffer, uint32_t length, uint64_t completion_time)
+{
+    pipeline_item item{port, buffer, buffer_id, length, completion_time};
+    // sized for every buffer of every thread, so this never spins in practice
+    while (!port->pipeline->work.try_push(item))
+    {
+        cpu_relax();
+    }
+    port->handed_off++;
+}
+
+void pipeline_reclaim(pipeline_port *port, bool *is_buffer_free, uint64_t now)
+{
+    if (port->last_sample)
+    {
+        port->held_ns += port->held() * (now - port->last_sample);
+        port->sampled_ns += now - port->last_sample;
+    }
+    port->last_sample = now;
+
+    uint32_t buffer_id;
+    while (port->returned->try_pop(buffer_id))
+    {
+        is_buffer_free[buffer_id] = true;
+        port->reclaimed++;
+    }
+}
+
+void pipeline_drain(pipeline_port *port, bool *is_buffer_free)
+{
+    uint32_t buffer_id;
+    while (port->held() > 0)
+    {
+        if (port->returned->try_pop(buffer_id))
+        {
+            is_buffer_free[buffer_id] = true;
+            port->reclaimed++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void print_pipeline_summary(compute_pipeline *pipeline, const benchmark_params &params,
+                            const std::vector<thread_stats> &thread_stats_list, double total_time)
+{
+    uint64_t buffers = 0, bytes = 0, busy_ns = 0, worker_ns = 0, run_start = UINT64_MAX, run_end = 0;
+    latency_histogram queue_wait;
+    for (const auto &stats : thread_stats_list)
+    {
+        run_start = std::min(run_start, stats.start_time);
+        run_end = std::max(run_end, stats.end_time);
+    }
+    // workers start before the I/O threads and idle after them: their load counts the reads only
+    uint64_t read_ns = run_end > run_start ? run_end - run_start : 0;
+    for (const auto &worker : pipeline->workers)
+    {
+        buffers += worker.buffers;
+        bytes += worker.bytes;
+        busy_ns += worker.busy_ns;
+        worker_ns += read_ns;
+        run_end = std::max(run_end, worker.end_time); // last buffer processed
+        queue_wait.merge(worker.queue_wait);
+    }
+
+    double held_ns = 0, sampled_ns = 0;
+    for (const auto &port : pipeline->ports)
+    {
+        held_ns += port->held_ns;
+        sampled_ns += port->sampled_ns;
+    }
+    double held = sampled_ns ? held_ns / (sampled_ns * pipeline->queue_depth) : 0;
+    double busy = worker_ns ? std::min(1.0, double(busy_ns) / worker_ns) : 0;
+    double end_to_end_seconds = std::max(total_time, (run_end - run_start) / 1e9);
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << "Pipeline (" << params.pipeline_spec << ", " << params.threads << " I/O threads, " << params.compute_threads
+        << " compute threads): " << buffers << " buffers processed, "
+        << (end_to_end_seconds > 0 ? bytes / end_to_end_seconds / (KILO * KILO) : 0) << " MB/s end to end\n"
+        << "Compute Stage: workers busy " << 100 * busy << "%, "
+        << (busy_ns ? double(bytes) / busy_ns * 1e9 / (KILO * KILO) : 0) << " MB/s per busy worker, "
+        << "holding " << 100 * held << "% of the read buffers on average\n";
+    std::cout << out.str() << std::flush;
+    print_latency_summary("Queue Wait", queue_wait);
+
+    // Busy workers that keep the reads short of buffers set the pace. Buffers piling up in
+    // front of idle workers mean the workers do not get the CPU. Otherwise they wait for reads.
+    std::ostringstream verdict;
+    verdict << std::fixed << std::setprecision(0) << "Bottleneck: ";
+    if (busy >= 0.9 || (held >= 0.5 && busy >= 0.5))
+    {
+        verdict << "compute (workers busy " << 100 * busy << "%, holding " << 100 * held
+                << "% of the read buffers; add --compute_threads)\n";
+    }
+    else if (held >= 0.5)
+    {
+        // buffers wait in the queue although the workers are mostly idle
+        verdict << "compute scheduling (workers hold " << 100 * held << "% of the read buffers but are busy only "
+                << 100 * busy << "%; they share CPUs with the I/O threads or each other)\n";
+    }
+    else
+    {
+        verdict << "I/O (workers idle " << 100 * (1 - busy) << "% of the run)\n";
+    }
+    std::cout << verdict.str() << std::flush;
+
+    delete pipeline;
+}
@@ -0,0 +1,201 @@
+#include "precondition.h"
+#include <atomic>
+#include <iomanip>
+
+static constexpr uint32_t precondition_seq_block_size = 128 * KIBI;
+static constexpr uint64_t precondition_queue_depth = 32;
+static constexpr uint64_t precondition_max_threads = 4;
+
+std::vector<precondition_step> parse_precondition(const std::string &spec, uint32_t page_size)
+{
+    std::vector<precondition_step> steps;
+    std::stringstream ss(spec);
+    std::string item;
+
+    while (std::getline(ss, item, ','))
+    {
+        std::string name = item.substr(0, item.find(':'));
+        std::string argument = item.find(':') == std::string::npos ? "" : item.substr(item.find(':') + 1);
+
+        if (name == "seq-fill" && argument.empty())
+        {
+            steps.push_back({name, true, 1, precondition_seq_block_size});
+        }
+        else if (name == "rand-fill")
+        {
+            uint64_t passes = argument.empty() ? 1 : std::stoull(argument);
+            if (passes == 0)
+            {
+                throw std::invalid_argument("rand-fill needs at least one pass");
+            }
+            steps.push_back({name, false, passes, page_size});
+        }
+        else
+        {
+            throw std::invalid_argument("unknown precondition step '" + item + "'");
+        }
+    }
+
+    if (steps.empty())
+    {
+        throw std::invalid_argument("empty precondition specification");
+    }
+    return steps;
+}
+
+struct precondition_progress
+{
+    std::atomic<uint64_t> bytes_written{0};
+    std::atomic<uint64_t> errors{0};
+};
+
+// One writer thread: `length` bytes, either the contiguous range starting at `start`
+// or random blocks anywhere on the device.
+static void precondition_thread(const benchmark_params &params, const precondition_step &step,
+                                uint64_t start, uint64_t length, uint64_t thread_id,
+                                precondition_progress &progress)
+{
+    pin_thread(thread_id);
+
+    struct io_uring ring;
+    if (io_uring_queue_init(precondition_queue_depth, &ring, 0) < 0)
+    {
+        std::cerr << "Error: io_uring initialization failed\n";
+        exit(1);
+    }
+
+    // Random content so that compressing or deduplicating drives cannot shortcut the fill
+    char *buffer = nullptr;
+    if (posix_memalign((void **)&buffer, params.page_size, step.block_size) != 0)
+    {
+        throw std::runtime_error("Error allocating buffer: " + std::string(strerror(errno)));
+    }
+    std::mt19937_64 rng(std::random_device{}() + thread_id);
+    for (uint64_t i = 0; i < step.block_size / sizeof(uint64_t); i++)
+    {
+        reinterpret_cast<uint64_t *>(buffer)[i] = rng();
+    }
+
+    uint64_t num_blocks = params.device_size / step.block_size;
+    std::uniform_int_distribution<uint64_t> dist(0, num_blocks - 1);
+
+    uint64_t issued = 0, in_flight = 0;
+    struct io_uring_cqe *cqes[precondition_queue_depth];
+
+    while (issued < length || in_flight > 0)
+    {
+        while (issued < length && in_flight < precondition_queue_depth)
+        {
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+            if (!sqe)
+            {
+                break;
+            }
+
+            uint64_t size = std::min<uint64_t>(step.block_size, length - issued);
+            uint64_t offset = step.sequential ? start + issued : dist(rng) * step.block_size;
+
+            // every write uses the same read-only buffer
+            io_uring_prep_write(sqe, params.fd, buffer, size, offset);
+            sqe->user_data = size;
+            issued += size;
+            in_flight++;
+        }
+
+        int ret = io_uring_submit_and_wait(&ring, 1);
+        if (ret < 0 && ret != -EINTR)
+        {
+            throw std::runtime_error("io_uring_submit failed: " + std::string(strerror(-ret)));
+        }
+
+        unsigned count = io_uring_peek_batch_cqe(&ring, cqes, precondition_queue_depth);
+        for (unsigned i = 0; i < count; i++)
+        {
+            if (cqes[i]->res < 0)
+            {
+                if (progress.errors++ == 0)
+                {
+                    std::cerr << "Precondition write error: " << strerror(-cqes[i]->res) << "\n";
+                }
+            }
+            else
+            {
+                progress.bytes_written += cqes[i]->res;
+            }
+            io_uring_cqe_seen(&ring, cqes[i]);
+        }
+        in_flight -= count;
+    }
+
+    io_uring_queue_exit(&ring);
+    free(buffer);
+}
+
+static void run_precondition_step(const benchmark_params &params, const precondition_step &step)
+{
+    uint64_t threads = std::min<uint64_t>(precondition_max_threads, std::thread::hardware_concurrency());
+    threads = std::max<uint64_t>(threads, 1);
+
+    // whole blocks only, split into contiguous per-thread regions for the sequential fill
+    uint64_t device_bytes = params.device_size / step.block_size * step.block_size;
+    uint64_t total = device_bytes * step.passes;
+    uint64_t region = (device_bytes / threads) / step.block_size * step.block_size;
+
+    precondition_progress progress;
+    std::vector<std::thread> workers;
+    for (uint64_t t = 0; t < threads; t++)
+    {
+        uint64_t start = t * region;
+        uint64_t length = step.sequential ? ((t == threads - 1) ? device_bytes - start : region)
+                                          : total / threads / step.block_size * step.block_size;
+        workers.emplace_back(precondition_thread, std::cref(params), std::cref(step), start, length, t, std::ref(progress));
+    }
+
+    // The workers may round the random share down, so stop on their completion, not on bytes
+    std::atomic<bool> done{false};
+    std::thread joiner([&]() {
+        for (auto &w : workers)
+        {
+            w.join();
+        }
+        done = true;
+    });
+
+    uint64_t start_time = get_current_time_ns();
+    uint64_t last_bytes = 0;
+    while (!done)
+    {
+        for (int i = 0; i < 10 && !done; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        uint64_t bytes = progress.bytes_written;
+        std::ostringstream line;
+        line << "Precondition " << step.name << ": "
+             << std::fixed << std::setprecision(1) << 100.0 * bytes / total << "%"
+             << ", " << byte_conversion(bytes, "binary") << " of " << byte_conversion(total, "binary")
+             << ", Bandwidth: " << (bytes - last_bytes) / double(KILO * KILO) << " MB/s";
+        std::cout << line.str() << std::endl;
+        last_bytes = bytes;
+    }
+    joiner.join();
+
+    double seconds = (get_current_time_ns() - start_time) / 1e9;
+    std::cout << "Precondition " << step.name << " done: " << byte_conversion(progress.bytes_written, "binary")
+              << " in " << seconds << " seconds (" << progress.bytes_written / seconds / (KILO * KILO) << " MB/s)";
+    if (progress.errors)
+    {
+        std::cout << ", " << progress.errors << " write errors";
+    }
+    std::cout << std::endl;
+}
+
+void run_precondition(const benchmark_params &params)
+{
+    for (const auto &step : parse_precondition(params.precondition, params.page_size))
+    {
+        run_precondition_step(params, step);
+    }
+    std::cout << "-----" << std::endl;
+}
@@ -0,0 +1,279 @@
+#include "replay.h"
+#include "trace.h"
+#include <fstream>
+
+static bool parse_op(const std::string &op, uint8_t &out)
+{
+    if (op == "R" || op == "r" || op == "read")
+    {
+        out = TRACE_OP_READ;
+        return true;
+    }
+    if (op == "W" || op == "w" || op == "write")
+    {
+        out = TRACE_OP_WRITE;
+        return true;
+    }
+    return false;
+}
+
+static std::vector<std::string> split(const std::string &line, char delimiter)
+{
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, delimiter))
+    {
+        field.erase(0, field.find_first_not_of(" \t\r"));
+        field.erase(field.find_last_not_of(" \t\r") + 1);
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+// blkparse default format: "maj,min cpu seq time pid action rwbs sector + blocks [process]"
+static bool parse_blkparse_line(const std::string &line, char &action, replay_entry &entry)
+{
+    std::istringstream ss(line);
+    std::string device, cpu, sequence, time, pid, act, rwbs, plus;
+    uint64_t sector, blocks;
+
+    if (!(ss >> device >> cpu >> sequence >> time >> pid >> act >> rwbs >> sector >> plus >> blocks) || plus != "+")
+    {
+        return false;
+    }
+    if (device.find(',') == std::string::npos || act.size() != 1)
+    {
+        return false;
+    }
+
+    // rwbs: R/W first, followed by modifiers (S, M, A, ...); discards and flushes are skipped
+    if (rwbs.find('D') != std::string::npos || blocks == 0)
+    {
+        return false;
+    }
+    if (rwbs.find('R') != std::string::npos)
+    {
+        entry.op = TRACE_OP_READ;
+    }
+    else if (rwbs.find('W') != std::string::npos)
+    {
+        entry.op = TRACE_OP_WRITE;
+    }
+    else
+    {
+        return false;
+    }
+
+    action = act[0];
+    entry.timestamp_ns = static_cast<uint64_t>(std::stod(time) * 1e9);
+    entry.offset = sector * 512;
+    entry.size = static_cast<uint32_t>(blocks * 512);
+    return true;
+}
+
+static void load_blkparse(std::ifstream &in, replay_trace *rt)
+{
+    std::vector<replay_entry> queued, issued;
+    std::string line;
+
+    while (std::getline(in, line))
+    {
+        char action;
+        replay_entry entry;
+        if (!parse_blkparse_line(line, action, entry))
+        {
+            continue; // summary lines, completions of other types, etc.
+        }
+        if (action == 'Q')
+        {
+            queued.push_back(entry);
+        }
+        else if (action == 'D')
+        {
+            issued.push_back(entry);
+        }
+    }
+
+    rt->entries = queued.empty() ? std::move(issued) : std::move(queued);
+}
+
+static void load_csv(std::ifstream &in, const std::string &first_line, replay_trace *rt)
+{
+    // column indexes of timestamp, op, offset and size
+    size_t columns[4] = {0, 1, 2, 3};
+    double timestamp_scale = 1e9; // seconds
+    std::string line = first_line;
+
+    std::vector<std::string> header = split(first_line, ',');
+    bool has_header = !header.empty() && !header[0].empty() && !isdigit(header[0][0]) && header[0][0] != '.';
+    if (has_header)
+    {
+        const char *names[4] = {"timestamp", "op", "offset", "size"};
+        for (int c = 0; c < 4; c++)
+        {
+            auto it = std::find(header.begin(), header.end(), names[c]);
+            if (c == 0 && it == header.end())
+            {
+                // io_trace2csv output
+                it = std::find(header.begin(), header.end(), "submit_ns");
+                timestamp_scale = 1;
+            }
+            if (it == header.end())
+            {
+                throw std::runtime_error("Replay CSV header has no '" + std::string(names[c]) + "' column");
+            }
+            columns[c] = it - header.begin();
+        }
+        if (!std::getline(in, line))
+        {
+            line.clear();
+        }
+    }
+
+    uint64_t line_number = has_header ? 1 : 0;
+    do
+    {
+        line_number++;
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        std::vector<std::string> fields = split(line, ',');
+        size_t needed = *std::max_element(columns, columns + 4);
+        replay_entry entry;
+        try
+        {
+            if (fields.size() <= needed || !parse_op(fields[columns[1]], entry.op))
+            {
+                throw std::invalid_argument("bad fields");
+            }
+            entry.timestamp_ns = static_cast<uint64_t>(std::stod(fields[columns[0]]) * timestamp_scale);
+            entry.offset = std::stoull(fields[columns[2]]);
+            entry.size = static_cast<uint32_t>(std::stoul(fields[columns[3]]));
+        }
+        catch (const std::exception &)
+        {
+            throw std::runtime_error("Malformed replay CSV line " + std::to_string(line_number) + ": " + line);
+        }
+
+        if (entry.size > 0)
+        {
+            rt->entries.push_back(entry);
+        }
+    } while (std::getline(in, line));
+}
+
+replay_trace *load_replay(const std::string &path, double speed)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        throw std::runtime_error("Error opening replay file " + path + ": " + std::string(strerror(errno)));
+    }
+
+    replay_trace *rt = new replay_trace();
+    rt->speed = speed;
+
+    std::string first_line;
+    while (std::getline(in, first_line) && (first_line.empty() || first_line[0] == '#'))
+    {
+    }
+
+    char action;
+    replay_entry probe;
+    if (parse_blkparse_line(first_line, action, probe))
+    {
+        in.clear();
+        in.seekg(0);
+        load_blkparse(in, rt);
+    }
+    else
+    {
+        load_csv(in, first_line, rt);
+    }
+
+    if (rt->entries.empty())
+    {
+        delete rt;
+        throw std::runtime_error("Replay file " + path + " contains no read or write requests");
+    }
+
+    std::stable_sort(rt->entries.begin(), rt->entries.end(),
+                     [](const replay_entry &a, const replay_entry &b) { return a.timestamp_ns < b.timestamp_ns; });
+
+    uint64_t first = rt->entries.front().timestamp_ns;
+    for (auto &entry : rt->entries)
+    {
+        entry.timestamp_ns -= first;
+        rt->has_writes |= entry.op == TRACE_OP_WRITE;
+    }
+
+    return rt;
+}
+
+void map_replay_to_device(replay_trace *rt, uint64_t region_offset, uint64_t region_size, uint32_t block_size)
+{
+    rt->max_size = 0;
+    for (auto &entry : rt->entries)
+    {
+        uint64_t size = (entry.size + block_size - 1) / block_size * block_size;
+        size = std::min<uint64_t>(size, region_size / block_size * block_size);
+
+        uint64_t offset = entry.offset % region_size / block_size * block_size;
+        if (offset + size > region_size)
+        {
+            offset = (region_size - size) / block_size * block_size;
+        }
+
+        entry.offset = region_offset + offset;
+        entry.size = static_cast<uint32_t>(size);
+        rt->max_size = std::max(rt->max_size, entry.size);
+    }
+}
+
+void replay_wait_until(uint64_t deadline_ns)
+{
+    static constexpr uint64_t spin_window_ns = 50 * KILO; // 50us
+
+    uint64_t now = get_current_time_ns();
+    if (deadline_ns > now + spin_window_ns)
+    {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(deadline_ns - now - spin_window_ns));
+    }
+    while (get_current_time_ns() < deadline_ns)
+    {
+    }
+}
+
+void print_replay_summary(const replay_trace *rt, const std::vector<thread_stats> &thread_stats_list)
+{
+    uint64_t issued = 0, lag_sum = 0, lag_max = 0, end_time = 0;
+    for (const auto &stats : thread_stats_list)
+    {
+        issued += stats.io_completed;
+        lag_sum += stats.replay_lag_sum;
+        lag_max = std::max(lag_max, stats.replay_lag_max);
+        end_time = std::max(end_time, stats.end_time);
+    }
+
+    double original = rt->entries.back().timestamp_ns / 1e9;
+    std::cout << "Replay: " << issued << " of " << rt->entries.size() << " requests"
+              << "\nReplay Original Duration: " << original << " seconds";
+
+    if (rt->speed > 0)
+    {
+        double scheduled = original / rt->speed;
+        double actual = (end_time - rt->start_ns) / 1e9;
+        std::cout << "\nReplay Speed: " << rt->speed << "x (scheduled " << scheduled << " seconds, took " << actual << " seconds)"
+                  << "\nReplay Lag: mean " << (issued ? lag_sum / issued : 0) / 1e3 << " us"
+                  << ", max " << lag_max / 1e3 << " us"
+                  << ", finished " << std::max(0.0, actual - scheduled) << " seconds behind schedule";
+    }
+    else
+    {
+        std::cout << "\nReplay Speed: as fast as possible";
+    }
+    std::cout << std::endl;
+}
@@ -0,0 +1,347 @@
+#include "ringshare.h"
+#include "async.h"
+#include "trace.h"
+#include "replay.h"
+#include <iomanip>
+
+// Submitters waiting for a ring lock spin this many times before yielding the CPU
+static constexpr uint64_t lock_spins_before_yield = 100;
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+static void lock_ring(shared_ring &shared)
+{
+    bool waited = false;
+    uint64_t spins = 0;
+    while (shared.locked.exchange(true, std::memory_order_acquire))
+    {
+        waited = true;
+        while (shared.locked.load(std::memory_order_relaxed))
+        {
+            if (++spins < lock_spins_before_yield)
+            {
+                cpu_relax();
+            }
+            else
+            {
+                std::this_thread::yield(); // the holder may be preempted on this core
+            }
+        }
+    }
+    shared.acquisitions++;
+    shared.contended += waited;
+}
+
+static bool try_lock_ring(shared_ring &shared)
+{
+    if (shared.locked.load(std::memory_order_relaxed) || shared.locked.exchange(true, std::memory_order_acquire))
+    {
+        return false;
+    }
+    return true;
+}
+
+static void unlock_ring(shared_ring &shared)
+{
+    shared.locked.store(false, std::memory_order_release);
+}
+
+// Reap every visible CQE and hand it to its submitter; call with the lock held
+static void reap_shared(shared_ring &shared, uint32_t self)
+{
+    static constexpr unsigned reap_batch = 64;
+    struct io_uring_cqe *cqes[reap_batch];
+    unsigned count;
+    while ((count = io_uring_peek_batch_cqe(&shared.ring, cqes, reap_batch)) > 0)
+    {
+        uint64_t now = get_current_time_ns();
+        for (unsigned i = 0; i < count; i++)
+        {
+            auto [owner, buffer_id] = extractBoth32(cqes[i]->user_data);
+            // every queue holds all I/Os its submitter can have in flight, so this never spins in practice
+            while (!shared.completions[owner]->try_push({buffer_id, cqes[i]->res, now}))
+            {
+                cpu_relax();
+            }
+            shared.reaped_for_others += owner != self;
+        }
+        io_uring_cq_advance(&shared.ring, count);
+        shared.reaped += count;
+    }
+}
+
+void open_wq_anchor(benchmark_params &params)
+{
+    // never torn down: the rings attached to it may outlive any scope we could give it
+    static struct io_uring anchor;
+    int ret = io_uring_queue_init(1, &anchor, 0);
+    if (ret < 0)
+    {
+        std::cerr << "Error: io_uring initialization of the --attach_wq anchor failed: " << strerror(-ret) << "\n";
+        exit(1);
+    }
+    params.wq_fd = anchor.ring_fd;
+}
+
+void shared_rings_start(benchmark_params &params)
+{
+    shared_ring_set *set = new shared_ring_set();
+    for (uint64_t first = 0; first < params.threads; first += params.submitters)
+    {
+        auto shared = std::make_unique<shared_ring>();
+        shared->submitters = std::min(params.submitters, params.threads - first);
+        init_liburing_ring(params, &shared->ring, shared->submitters * params.queue_depth);
+        for (uint64_t i = 0; i < shared->submitters; i++)
+        {
+            shared->completions.push_back(std::make_unique<mpmc_queue<shared_completion>>(params.queue_depth));
+        }
+        set->rings.push_back(std::move(shared));
+    }
+    params.shared_rings = set;
+}
+
+void shared_rings_stop(benchmark_params &params)
+{
+    for (auto &shared : params.shared_rings->rings)
+    {
+        io_uring_queue_exit(&shared->ring);
+    }
+    delete params.shared_rings;
+    params.shared_rings = nullptr;
+}
+
+void time_benchmark_thread_shared(benchmark_params &params, thread_stats &stats, uint64_t thread_id)
+{
+    uint64_t group = thread_id / params.submitters;
+    uint32_t self = thread_id % params.submitters;
+    shared_ring &shared = *params.shared_rings->rings[group];
+    mpmc_queue<shared_completion> &completions = *shared.completions[self];
+
+    // one core per ring: the submitters of a ring take turns on it
+    pin_thread(params.first_cpu + group);
+
+    params.io = params.duration * 1e6; // estimate number of I/O operations
+    std::vector<uint64_t> offsets = generate_offsets(params, thread_id);
+    trace_ring *trace = get_trace_ring(params, thread_id);
+    bool is_write = params.read_or_write == "write";
+    uint8_t trace_op = is_write ? TRACE_OP_WRITE : TRACE_OP_READ;
+
+    std::vector<char *> buffers(params.queue_depth);
+    bool *is_buffer_free = new bool[params.queue_depth];
+    std::vector<uint64_t> prep_times(params.queue_depth);
+    std::vector<uint32_t> request_ids(params.queue_depth); // user_data carries the submitter instead
+    std::vector<uint32_t> queued_depths(params.queue_depth);
+    std::vector<uint32_t> bytes_done(params.queue_depth);  // short transfers are resubmitted for the rest
+    for (uint64_t i = 0; i < params.queue_depth; i++)
+    {
+        if (posix_memalign((void **)&buffers[i], params.page_size, params.page_size) != 0)
+        {
+            throw std::runtime_error("Error allocating buffer: " + std::string(strerror(errno)));
+        }
+        is_buffer_free[i] = true;
+    }
+
+    std::vector<uint32_t> pending; // buffers whose request waits for the ring lock
+    pending.reserve(params.queue_depth);
+    uint64_t submitted = 0, in_flight = 0;
+
+    auto handle = [&](const shared_completion &c) {
+        uint32_t id = c.buffer_id;
+        uint64_t offset = offsets[request_ids[id]];
+        if (c.res <= 0)
+        {
+            std::cerr << "I/O error on request " << request_ids[id] << ": "
+                      << (c.res < 0 ? strerror(-c.res) : "end of device") << "\n";
+            if (trace)
+            {
+                trace_push(trace, trace_op, offset, params.page_size, prep_times[id], c.completion_time, c.res);
+            }
+        }
+        else if (bytes_done[id] + c.res < static_cast<uint32_t>(params.page_size))
+        {
+            bytes_done[id] += c.res;
+            pending.push_back(id);
+            return;
+        }
+        else
+        {
+            stats.io_completed++;
+            stats.latency.record(c.completion_time - prep_times[id]);
+            record_outlier(stats.outliers, trace_op, offset, params.page_size, prep_times[id],
+                           c.completion_time - prep_times[id], queued_depths[id]);
+            if (trace)
+            {
+                trace_push(trace, trace_op, offset, params.page_size, prep_times[id], c.completion_time, params.page_size);
+            }
+        }
+        is_buffer_free[id] = true;
+        in_flight--;
+    };
+    auto handle_completions = [&]() {
+        shared_completion c;
+        bool any = false;
+        while (completions.try_pop(c))
+        {
+            handle(c);
+            any = true;
+        }
+        return any;
+    };
+
+    // Prepare the pending requests, submit them and reap for everyone; call with the lock held
+    auto submit_pending = [&]() {
+        size_t queued = 0;
+        for (; queued < pending.size(); queued++)
+        {
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&shared.ring);
+            if (!sqe)
+            {
+                break; // the other submitters filled the SQ; the rest goes with the next round
+            }
+            uint32_t id = pending[queued];
+            char *buffer = buffers[id] + bytes_done[id];
+            uint32_t length = params.page_size - bytes_done[id];
+            uint64_t offset = offsets[request_ids[id]] + bytes_done[id];
+            if (is_write)
+            {
+                io_uring_prep_write(sqe, params.fd, buffer, length, offset);
+            }
+            else
+            {
+                io_uring_prep_read(sqe, params.fd, buffer, length, offset);
+            }
+            sqe->ioprio = params.ioprio;
+            sqe->user_data = combine32To64(self, id);
+        }
+        pending.erase(pending.begin(), pending.begin() + queued);
+
+        if (queued)
+        {
+            int ret = io_uring_submit(&shared.ring);
+            if (ret < 0)
+            {
+                unlock_ring(shared);
+                throw std::runtime_error("io_uring_submit failed: " + std::string(strerror(-ret)));
+            }
+        }
+        reap_shared(shared, self);
+    };
+
+    stats.start_time = get_current_time_ns();
+
+    while (true)
+    {
+        uint64_t current_time = get_current_time_ns();
+        if (current_time - stats.start_time >= params.duration * 1e9)
+        {
+            break;
+        }
+
+        handle_completions();
+
+        while (in_flight < params.queue_depth && rate_due_time(params, stats.start_time, submitted) <= current_time)
+        {
+            uint32_t id = acquire_buffer(is_buffer_free, params.queue_depth);
+            request_ids[id] = submitted % params.io;
+            prep_times[id] = current_time;
+            bytes_done[id] = 0;
+            queued_depths[id] = ++in_flight;
+            pending.push_back(id);
+            submitted++;
+        }
+
+        if (in_flight == 0)
+        {
+            // rate limited with nothing in flight: sleep until the next I/O is due
+            replay_wait_until(std::min<uint64_t>(rate_due_time(params, stats.start_time, submitted),
+                                                 stats.start_time + params.duration * 1e9));
+            continue;
+        }
+
+        if (pending.empty())
+        {
+            // nothing to submit: whoever holds the lock reaps our completions too
+            if (!try_lock_ring(shared))
+            {
+                cpu_relax();
+                continue;
+            }
+        }
+        else
+        {
+            lock_ring(shared);
+        }
+        submit_pending();
+        unlock_ring(shared);
+
+        if (!handle_completions() && pending.empty() && params.wait == wait_strategy::timeout)
+        {
+            // Sleep outside the lock until the ring has a completion, ours or not. Another
+            // submitter may reap ours first and leave the ring empty, so the wait is bounded.
+            struct __kernel_timespec ts = {0, static_cast<long long>(params.wait_us * KILO)};
+            ts.tv_sec = ts.tv_nsec / 1000000000;
+            ts.tv_nsec %= 1000000000;
+            struct io_uring_getevents_arg arg;
+            memset(&arg, 0, sizeof(arg));
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+            io_uring_enter2(shared.ring.ring_fd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                            reinterpret_cast<sigset_t *>(&arg), sizeof(arg));
+        }
+    }
+
+    stats.end_time = get_current_time_ns();
+
+    // The ring outlives this thread but the buffers do not: wait for the I/O still in
+    // flight without counting it. Requests that never reached the ring are dropped.
+    in_flight -= pending.size();
+    pending.clear();
+    while (in_flight > 0)
+    {
+        lock_ring(shared);
+        reap_shared(shared, self);
+        unlock_ring(shared);
+        shared_completion c;
+        bool any = false;
+        while (completions.try_pop(c))
+        {
+            in_flight--;
+            any = true;
+        }
+        if (!any)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    for (uint64_t i = 0; i < params.queue_depth; i++)
+    {
+        free(buffers[i]);
+    }
+    delete[] is_buffer_free;
+}
+
+void print_shared_ring_summary(const benchmark_params &params)
+{
+    uint64_t acquisitions = 0, contended = 0, reaped = 0, reaped_for_others = 0;
+    for (const auto &shared : params.shared_rings->rings)
+    {
+        acquisitions += shared->acquisitions;
+        contended += shared->contended;
+        reaped += shared->reaped;
+        reaped_for_others += shared->reaped_for_others;
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << "Shared Rings: " << params.shared_rings->rings.size() << " rings x " << params.submitters
+        << " submitters, lock taken " << acquisitions << " times to submit ("
+        << (acquisitions ? 100.0 * contended / acquisitions : 0) << "% contended), "
+        << (reaped ? 100.0 * reaped_for_others / reaped : 0) << "% of " << reaped
+        << " completions reaped by another submitter\n";
+    std::cout << out.str() << std::flush;
+}
@@ -1,11 +1,76 @@
 #include "sync.h"
 #include "config.h"
+#include "trace.h"
+#include "replay.h"
+#include "verify.h"
+
+// Flush after every params.flush_interval writes, timing the flush on its own
+static void flush_if_due(benchmark_params &params, thread_stats &stats, uint64_t &writes_since_flush, trace_ring *trace)
+{
+    if (params.flush_interval == 0 || ++writes_since_flush < params.flush_interval)
+    {
+        return;
+    }
+    writes_since_flush = 0;
+
+    uint64_t start = get_current_time_ns();
+    int ret = params.flush_datasync ? fdatasync(params.fd) : fsync(params.fd);
+    int err = ret == 0 ? 0 : errno;
+    uint64_t end = get_current_time_ns();
+
+    if (ret != 0)
+    {
+        std::cerr << "Flush error: " << strerror(err) << "\n";
+    }
+    stats.flushes_completed++;
+    stats.flush_latency.record(end - start);
+    if (trace)
+    {
+        trace_push(trace, TRACE_OP_FLUSH, 0, 0, start, end, -err);
+    }
+}
+
+// Trace op of --type
+static uint8_t type_trace_op(const std::string &type)
+{
+    if (type == "write")
+    {
+        return TRACE_OP_WRITE;
+    }
+    if (type == "trim")
+    {
+        return TRACE_OP_TRIM;
+    }
+    if (type == "write_zeroes")
+    {
+        return TRACE_OP_WRITE_ZEROES;
+    }
+    return TRACE_OP_READ;
+}
+
+// --type=trim|write_zeroes: one range operation without data. Block devices get the
+// BLKDISCARD/BLKZEROOUT ioctls, regular files a punched hole or a zeroed range.
+static bool range_operation(const benchmark_params &params, uint8_t op, uint64_t offset, uint64_t length)
+{
+    if (params.block_device)
+    {
+        uint64_t range[2] = {offset, length};
+        return ioctl(params.fd, op == TRACE_OP_TRIM ? BLKDISCARD : BLKZEROOUT, range) == 0;
+    }
+    int mode = (op == TRACE_OP_TRIM ? FALLOC_FL_PUNCH_HOLE : FALLOC_FL_ZERO_RANGE) | FALLOC_FL_KEEP_SIZE;
+    return fallocate(params.fd, mode, offset, length) == 0;
+}
 
 void io_benchmark_thread_sync(benchmark_params &params, thread_stats &stats, uint64_t thread_id)
 {
+    set_thread_ioprio(params);
+
     // Generate offsets
     std::vector<uint64_t> offsets = generate_offsets(params, thread_id);
     stats.latencies.resize(params.io, 0);
+    trace_ring *trace = get_trace_ring(params, thread_id);
+    uint8_t trace_op = type_trace_op(params.read_or_write);
+    bool range_op = trace_op == TRACE_OP_TRIM || trace_op == TRACE_OP_WRITE_ZEROES;
 
     // allocate buffer
     char *buffer = nullptr;
@@ -13,14 +78,29 @@ void io_benchmark_thread_sync(benchmark_params &params, thread_stats &stats, uin
     {
         throw std::runtime_error("Error allocating buffer: " + std::string(strerror(errno)));
     }
+    verify_prepare_buffer(params, buffer, params.page_size);
 
     int ret = 0;
+    uint64_t writes_since_flush = 0;
     stats.start_time = get_current_time_ns();
 
     for (uint64_t i = 0; i < params.io; ++i)
     {
-        uint64_t current_time = get_current_time_ns();
         if (params.read_or_write == "write")
+        {
+            verify_write(params, stats, buffer, offsets[i], thread_id);
+        }
+        uint64_t current_time = get_current_time_ns();
+        if (range_op)
+        {
+            ret = range_operation(params, trace_op, offsets[i], params.page_size) ? params.page_size : -errno;
+            if (ret < 0)
+            {
+                std::cerr << "Thread " << thread_id << " encountered an error: " << strerror(-ret)
+                          << " at offset " << offsets[i] << "\n";
+            }
+        }
+        else if (params.read_or_write == "write")
         {
             while (ret < params.page_size)
             {
@@ -35,8 +115,23 @@ void io_benchmark_thread_sync(benchmark_params &params, thread_stats &stats, uin
             }
         }
 
+        uint64_t completion_time = get_current_time_ns();
         stats.io_completed++;
-        stats.latencies[i] = get_current_time_ns() - current_time;
+        stats.latencies[i] = completion_time - current_time;
+        stats.latency.record(completion_time - current_time);
+        if (params.read_or_write == "read")
+        {
+            verify_read(params.verify, stats, buffer, params.page_size, offsets[i]);
+        }
+        record_outlier(stats.outliers, trace_op, offsets[i], params.page_size, current_time, completion_time - current_time, 1);
+        if (trace)
+        {
+            trace_push(trace, trace_op, offsets[i], params.page_size, current_time, completion_time, ret);
+        }
+        if (params.read_or_write == "write")
+        {
+            flush_if_due(params, stats, writes_since_flush, trace);
+        }
         ret = 0;
     }
 
@@ -49,13 +144,17 @@ void io_benchmark_thread_sync(benchmark_params &params, thread_stats &stats, uin
 void time_benchmark_thread_sync(benchmark_params &params, thread_stats &stats, uint64_t thread_id)
 {
 
-    pin_thread(thread_id);
+    pin_thread(params.first_cpu + thread_id);
+    set_thread_ioprio(params);
 
     params.io = 1e6 * params.duration; // 1M I/O operations per second theoretically
     stats.latencies.resize(params.io, 0);
 
     // Generate initial offsets
     std::vector<uint64_t> offsets = generate_offsets(params, thread_id);
+    trace_ring *trace = get_trace_ring(params, thread_id);
+    uint8_t trace_op = type_trace_op(params.read_or_write);
+    bool range_op = trace_op == TRACE_OP_TRIM || trace_op == TRACE_OP_WRITE_ZEROES;
 
     // Allocate a buffer aligned to the page size
     char *buffer = nullptr;
@@ -63,8 +162,23 @@ void time_benchmark_thread_sync(benchmark_params &params, thread_stats &stats, u
     {
         throw std::runtime_error("Error allocating buffer: " + std::string(strerror(errno)));
     }
+    verify_prepare_buffer(params, buffer, params.page_size);
+
+    // --coalesce: one page buffer per merged I/O, each allocated on its own like the
+    // buffers of independent requests
+    std::vector<struct iovec> iovecs(params.coalesce > 1 ? params.coalesce : 0);
+    std::vector<char *> coalesce_buffers(iovecs.size());
+    for (auto &b : coalesce_buffers)
+    {
+        if (posix_memalign((void **)&b, params.page_size, params.page_size) != 0)
+        {
+            throw std::runtime_error("Error allocating buffer: " + std::string(strerror(errno)));
+        }
+    }
 
     int ret = 0;
+    int err = 0; // errno of the last failed I/O, saved before anything can overwrite it
+    uint64_t writes_since_flush = 0;
     stats.start_time = get_current_time_ns();
 
     while (true)
@@ -75,7 +189,89 @@ void time_benchmark_thread_sync(benchmark_params &params, thread_stats &stats, u
             break;
         }
 
-        while (ret < params.page_size)
+        uint64_t due_time = rate_due_time(params, stats.start_time, stats.io_completed);
+        if (due_time > current_time)
+        {
+            // --rate_iops: sleep until the next I/O is due
+            replay_wait_until(std::min<uint64_t>(due_time, stats.start_time + params.duration * 1e9));
+            continue;
+        }
+
+        if (params.coalesce > 1)
+        {
+            // one preadv/pwritev over the next contiguous I/Os that are already due
+            uint64_t first = stats.io_completed;
+            uint32_t count = contiguous_ios(params, offsets, first, params.coalesce);
+            while (count > 1 && rate_due_time(params, stats.start_time, first + count - 1) > current_time)
+            {
+                count--;
+            }
+            for (uint32_t j = 0; j < count; j++)
+            {
+                iovecs[j] = {coalesce_buffers[j], static_cast<size_t>(params.page_size)};
+            }
+            uint64_t offset = offsets[first % params.io];
+            uint64_t length = uint64_t(count) * params.page_size, done = 0;
+            uint32_t next = 0;
+            while (done < length)
+            {
+                ssize_t bytes = (params.read_or_write == "write")
+                                    ? pwritev(params.fd, &iovecs[next], count - next, offset + done)
+                                    : preadv(params.fd, &iovecs[next], count - next, offset + done);
+                if (bytes <= 0)
+                {
+                    err = bytes < 0 ? errno : EIO;
+                    std::cerr << "Thread " << thread_id << " encountered an error: "
+                              << (bytes < 0 ? strerror(err) : "end of device") << " at offset " << offset << "\n";
+                    break;
+                }
+                done += bytes;
+                next = advance_iovecs(iovecs.data(), next, count, bytes);
+            }
+
+            // every merged I/O counts, and completes with the request
+            uint64_t completion_time = get_current_time_ns();
+            stats.io_completed += count;
+            if (done == length)
+            {
+                stats.coalesced_requests++;
+                for (uint64_t i = first; i < first + count; i++)
+                {
+                    stats.latencies[i % params.io] = completion_time - current_time;
+                    stats.latency.record(completion_time - current_time);
+                }
+                record_outlier(stats.outliers, trace_op, offset, length, current_time, completion_time - current_time, 1);
+            }
+            if (trace)
+            {
+                trace_push(trace, trace_op, offset, length, current_time, completion_time,
+                           done == length ? static_cast<int32_t>(length) : -err);
+            }
+            continue;
+        }
+
+        if (params.verify != verify_algorithm::none && params.read_or_write == "write")
+        {
+            // stamp outside the timed region
+            verify_stamp_block(params, stats, buffer, offsets[stats.io_completed % params.io], thread_id);
+            current_time = get_current_time_ns();
+        }
+
+        if (range_op)
+        {
+            if (range_operation(params, trace_op, offsets[stats.io_completed % params.io], params.page_size))
+            {
+                ret = params.page_size;
+            }
+            else
+            {
+                err = errno;
+                std::cerr << "Thread " << thread_id << " encountered an error: " << strerror(err)
+                          << " at offset " << offsets[stats.io_completed % params.io] << "\n";
+            }
+        }
+
+        while (!range_op && ret < params.page_size)
         {
             int bytes = (params.read_or_write == "write")
                             ? pwrite(params.fd, buffer + ret, params.page_size - ret, offsets[stats.io_completed % params.io] + ret)
@@ -84,8 +280,9 @@ void time_benchmark_thread_sync(benchmark_params &params, thread_stats &stats, u
             if (bytes == -1)
             {
                 // Log the error and continue
+                err = errno;
                 std::cerr << "Thread " << thread_id << " encountered an error: "
-                          << strerror(errno)
+                          << strerror(err)
                           << " at offset " << offsets[stats.io_completed % params.io]
                           << "\n";
 
@@ -103,7 +300,28 @@ void time_benchmark_thread_sync(benchmark_params &params, thread_stats &stats, u
         // Log latency only for successful I/O
         if (ret > 0)
         {
-            stats.latencies[stats.io_completed - 1] = get_current_time_ns() - current_time;
+            uint64_t completion_time = get_current_time_ns();
+            stats.latencies[stats.io_completed - 1] = completion_time - current_time;
+            stats.latency.record(completion_time - current_time);
+            record_outlier(stats.outliers, trace_op, offsets[(stats.io_completed - 1) % params.io], params.page_size,
+                           current_time, completion_time - current_time, 1);
+            if (params.read_or_write == "read" && ret == params.page_size)
+            {
+                verify_read(params.verify, stats, buffer, params.page_size, offsets[(stats.io_completed - 1) % params.io]);
+            }
+            if (trace)
+            {
+                trace_push(trace, trace_op, offsets[(stats.io_completed - 1) % params.io], params.page_size, current_time, completion_time, ret);
+            }
+        }
+        else if (trace)
+        {
+            trace_push(trace, trace_op, offsets[(stats.io_completed - 1) % params.io], params.page_size, current_time, get_current_time_ns(), -err);
+        }
+
+        if (params.read_or_write == "write")
+        {
+            flush_if_due(params, stats, writes_since_flush, trace);
         }
 
         ret = 0; // Reset for the next iteration
@@ -111,6 +329,72 @@ void time_benchmark_thread_sync(benchmark_params &params, thread_stats &stats, u
 
     stats.end_time = get_current_time_ns();
 
-    // Free the allocated buffer
+    // Free the allocated buffers
+    free(buffer);
+    for (char *b : coalesce_buffers)
+    {
+        free(b);
+    }
+}
+
+void replay_benchmark_thread_sync(benchmark_params &params, thread_stats &stats, uint64_t thread_id)
+{
+    pin_thread(params.first_cpu + thread_id);
+    set_thread_ioprio(params);
+
+    replay_trace *replay = params.replay;
+    trace_ring *trace = get_trace_ring(params, thread_id);
+
+    char *buffer = nullptr;
+    if (posix_memalign((void **)&buffer, params.page_size, replay->max_size) != 0)
+    {
+        throw std::runtime_error("Error allocating buffer: " + std::string(strerror(errno)));
+    }
+
+    stats.start_time = get_current_time_ns();
+
+    for (uint64_t i = thread_id; i < replay->entries.size(); i += params.threads)
+    {
+        const replay_entry &entry = replay->entries[i];
+        uint64_t deadline = replay_deadline(replay, entry);
+        replay_wait_until(deadline);
+
+        uint64_t current_time = get_current_time_ns();
+        replay_record_lag(stats, current_time, deadline);
+
+        int64_t ret = 0;
+        while (ret < entry.size)
+        {
+            ssize_t bytes = (entry.op == TRACE_OP_WRITE)
+                                ? pwrite(params.fd, buffer + ret, entry.size - ret, entry.offset + ret)
+                                : pread(params.fd, buffer + ret, entry.size - ret, entry.offset + ret);
+            if (bytes <= 0)
+            {
+                // a zero-byte transfer ends at the device end and leaves errno alone
+                int err = bytes < 0 ? errno : EIO;
+                std::cerr << "Thread " << thread_id << " encountered an error: "
+                          << strerror(err) << " at offset " << entry.offset << "\n";
+                ret = -err;
+                break;
+            }
+            ret += bytes;
+        }
+
+        uint64_t completion_time = get_current_time_ns();
+        stats.io_completed++;
+        if (ret > 0)
+        {
+            stats.bytes_completed += ret;
+            stats.latency.record(completion_time - current_time);
+            record_outlier(stats.outliers, entry.op, entry.offset, entry.size, current_time, completion_time - current_time, 1);
+        }
+        if (trace)
+        {
+            trace_push(trace, entry.op, entry.offset, entry.size, current_time, completion_time, ret);
+        }
+    }
+
+    stats.end_time = get_current_time_ns();
+
     free(buffer);
 }
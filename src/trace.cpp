@@ -0,0 +1,177 @@
+#include "trace.h"
+
+static constexpr uint64_t trace_ring_records = 1 << 17;       // 4 MiB of records per thread
+static constexpr uint64_t trace_staging_size = KIBI * KIBI;     // 1 MiB per file write
+static constexpr uint64_t trace_alignment = 4096;
+
+static void trace_write_staging(trace_writer *tw, bool final)
+{
+    if (tw->staging_used == 0)
+    {
+        return;
+    }
+
+    uint64_t length = tw->staging_used;
+    if (final && tw->direct)
+    {
+        // O_DIRECT needs whole blocks; the padding is cut off again by ftruncate in trace_close
+        length = (length + trace_alignment - 1) / trace_alignment * trace_alignment;
+        memset(tw->staging + tw->staging_used, 0, length - tw->staging_used);
+    }
+
+    uint64_t written = 0;
+    while (written < length)
+    {
+        ssize_t ret = pwrite(tw->fd, tw->staging + written, length - written, tw->file_offset + written);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            std::cerr << "Error writing trace file: " << strerror(errno) << std::endl;
+            break;
+        }
+        written += ret;
+    }
+
+    tw->file_offset += tw->staging_used;
+    tw->staging_used = 0;
+}
+
+static void trace_append(trace_writer *tw, const void *data, uint64_t length)
+{
+    const char *src = static_cast<const char *>(data);
+    while (length > 0)
+    {
+        uint64_t chunk = std::min(length, trace_staging_size - tw->staging_used);
+        memcpy(tw->staging + tw->staging_used, src, chunk);
+        tw->staging_used += chunk;
+        src += chunk;
+        length -= chunk;
+
+        if (tw->staging_used == trace_staging_size)
+        {
+            trace_write_staging(tw, false);
+        }
+    }
+}
+
+// Move every record currently in the ring into the staging block
+static uint64_t trace_drain_ring(trace_writer *tw, trace_ring &ring)
+{
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    uint64_t tail = ring.tail.load(std::memory_order_acquire);
+    uint64_t count = tail - head;
+
+    while (head != tail)
+    {
+        // copy up to the end of the ring in one go
+        uint64_t index = head & ring.mask;
+        uint64_t chunk = std::min(tail - head, ring.mask + 1 - index);
+        trace_append(tw, &ring.records[index], chunk * sizeof(trace_record));
+        head += chunk;
+    }
+
+    ring.head.store(head, std::memory_order_release);
+    tw->records_written += count;
+    return count;
+}
+
+static void trace_flusher_thread(trace_writer *tw)
+{
+    while (tw->running.load(std::memory_order_acquire))
+    {
+        uint64_t drained = 0;
+        for (auto &ring : tw->rings)
+        {
+            drained += trace_drain_ring(tw, ring);
+        }
+
+        if (drained == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+trace_writer *trace_open(const std::string &path, uint64_t threads)
+{
+    trace_writer *tw = new trace_writer();
+    tw->path = path;
+
+    tw->fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    tw->direct = true;
+    if (tw->fd == -1 && errno == EINVAL)
+    {
+        // e.g. tmpfs does not support O_DIRECT
+        tw->fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        tw->direct = false;
+    }
+    if (tw->fd == -1)
+    {
+        throw std::runtime_error("Error opening trace file " + path + ": " + std::string(strerror(errno)));
+    }
+
+    if (posix_memalign((void **)&tw->staging, trace_alignment, trace_staging_size) != 0)
+    {
+        throw std::runtime_error("Error allocating trace buffer: " + std::string(strerror(errno)));
+    }
+
+    tw->rings = std::vector<trace_ring>(threads);
+    for (uint64_t i = 0; i < threads; i++)
+    {
+        trace_ring &ring = tw->rings[i];
+        ring.thread_id = static_cast<uint16_t>(i);
+        ring.mask = trace_ring_records - 1;
+        ring.records = new trace_record[trace_ring_records];
+        // touch the ring now so page faults do not land on the I/O path
+        memset(ring.records, 0, trace_ring_records * sizeof(trace_record));
+    }
+
+    trace_file_header header = {};
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(trace_record);
+    header.start_ns = get_current_time_ns();
+    trace_append(tw, &header, sizeof(header));
+
+    tw->running = true;
+    tw->flusher = std::thread(trace_flusher_thread, tw);
+
+    return tw;
+}
+
+void trace_close(trace_writer *tw)
+{
+    tw->running = false;
+    tw->flusher.join();
+
+    uint64_t dropped = 0;
+    for (auto &ring : tw->rings)
+    {
+        trace_drain_ring(tw, ring);
+        dropped += ring.dropped;
+    }
+    trace_write_staging(tw, true);
+
+    if (tw->direct && ftruncate(tw->fd, tw->file_offset) != 0)
+    {
+        std::cerr << "Error truncating trace file: " << strerror(errno) << std::endl;
+    }
+    close(tw->fd);
+
+    std::cout << "Trace: " << tw->records_written << " records written to " << tw->path;
+    if (dropped > 0)
+    {
+        std::cout << ", " << dropped << " records dropped (flusher fell behind)";
+    }
+    std::cout << std::endl;
+
+    for (auto &ring : tw->rings)
+    {
+        delete[] ring.records;
+    }
+    free(tw->staging);
+    delete tw;
+}
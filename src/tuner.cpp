@@ -0,0 +1,419 @@
+#include "tuner.h"
+#include "sync.h"
+#include "async.h"
+#include "iou.h"
+#include "coro.h"
+#include "ringshare.h"
+#include "baseline.h"
+#include <iomanip>
+#include <sys/resource.h>
+#include <map>
+
+latency_slo parse_slo(const std::string &spec)
+{
+    size_t colon = spec.find(':');
+    if (spec.size() < 2 || spec[0] != 'p' || colon == std::string::npos)
+    {
+        throw std::invalid_argument("expected p<percentile>:<latency>, e.g. p99:500us");
+    }
+
+    latency_slo slo;
+    slo.percentile = std::stod(spec.substr(1, colon - 1));
+    if (slo.percentile <= 0 || slo.percentile >= 100)
+    {
+        throw std::invalid_argument("percentile must be between 0 and 100");
+    }
+
+    std::string latency = spec.substr(colon + 1);
+    size_t unit_pos = latency.find_first_not_of("0123456789.");
+    if (unit_pos == 0)
+    {
+        throw std::invalid_argument("missing latency value");
+    }
+    double value = std::stod(latency.substr(0, unit_pos));
+    std::string unit = unit_pos == std::string::npos ? "us" : latency.substr(unit_pos);
+
+    static const std::map<std::string, double> units = {{"ns", 1}, {"us", 1e3}, {"ms", 1e6}, {"s", 1e9}};
+    if (units.find(unit) == units.end())
+    {
+        throw std::invalid_argument("unknown latency unit '" + unit + "' (use ns, us, ms or s)");
+    }
+    slo.latency_ns = static_cast<uint64_t>(value * units.at(unit));
+    if (slo.latency_ns == 0)
+    {
+        throw std::invalid_argument("latency must be positive");
+    }
+    return slo;
+}
+
+struct tuner_point
+{
+    uint64_t threads;
+    uint64_t queue_depth;
+    uint64_t io_completed;
+    double seconds;
+    double iops;
+    uint64_t slo_latency_ns; // latency at the SLO percentile
+    latency_histogram latency;
+    bool meets_slo;
+};
+
+// 1, 2, 4, ... limit, then past the limit to end the loop
+static uint64_t next_search_value(uint64_t value, uint64_t limit)
+{
+    return value == limit ? limit + 1 : std::min(value * 2, limit);
+}
+
+struct step_result
+{
+    uint64_t io_completed = 0;
+    double seconds = 0;
+    double iops = 0;
+    latency_histogram latency;
+};
+
+// One measurement step with the regular time-based workers and the current params
+static step_result run_step(benchmark_params &params)
+{
+    std::vector<thread_stats> thread_stats_list(params.threads);
+    std::vector<std::thread> workers;
+    if (params.submitters > 1)
+    {
+        shared_rings_start(params);
+    }
+    for (uint64_t i = 0; i < params.threads; i++)
+    {
+        if (params.submitters > 1)
+        {
+            workers.push_back(std::thread(time_benchmark_thread_shared, std::ref(params), std::ref(thread_stats_list[i]), i));
+        }
+        else if (params.engine == "sync")
+        {
+            workers.push_back(std::thread(time_benchmark_thread_sync, std::ref(params), std::ref(thread_stats_list[i]), i));
+        }
+        else if (params.engine == "liburing")
+        {
+            workers.push_back(std::thread(time_benchmark_thread_async, std::ref(params), std::ref(thread_stats_list[i]), i));
+        }
+        else if (params.engine == "coro")
+        {
+            workers.push_back(std::thread(time_benchmark_thread_coro, std::ref(params), std::ref(thread_stats_list[i]), i));
+        }
+        else
+        {
+            workers.push_back(std::thread(time_benchmark_thread_iou, std::ref(params), std::ref(thread_stats_list[i]), i));
+        }
+    }
+    for (auto &t : workers)
+    {
+        t.join();
+    }
+    if (params.shared_rings)
+    {
+        shared_rings_stop(params);
+    }
+
+    step_result result;
+    for (const auto &stats : thread_stats_list)
+    {
+        result.io_completed += stats.io_completed;
+        result.latency.merge(stats.latency);
+        result.seconds = std::max(result.seconds, (stats.end_time - stats.start_time) / 1e9);
+    }
+    result.iops = result.seconds > 0 ? result.io_completed / result.seconds : 0;
+    return result;
+}
+
+static tuner_point measure(benchmark_params &params, const latency_slo &slo, uint64_t threads, uint64_t queue_depth)
+{
+    params.threads = threads;
+    params.queue_depth = queue_depth;
+    step_result step = run_step(params);
+
+    std::ostringstream label;
+    label << "p" << slo.percentile;
+
+    tuner_point point = {threads, queue_depth, step.io_completed, step.seconds, step.iops, 0, step.latency, false};
+    point.slo_latency_ns = point.latency.percentile(slo.percentile);
+    point.meets_slo = point.latency.total > 0 && point.slo_latency_ns <= slo.latency_ns;
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2)
+         << "Step: Threads " << std::setw(3) << threads
+         << "  QD " << std::setw(4) << queue_depth
+         << "  IOPS " << std::setw(12) << point.iops
+         << "  " << label.str() << " " << std::setw(10) << point.slo_latency_ns / 1e3 << " us"
+         << (point.meets_slo ? "  ok" : "  SLO violated");
+    std::cout << line.str() << std::endl;
+    return point;
+}
+
+// Best SLO-compliant point for one thread count: ramp the queue depth by doubling, then bisect
+static const tuner_point *search_queue_depth(benchmark_params &params, const latency_slo &slo, uint64_t threads,
+                                             uint64_t max_queue_depth, std::vector<tuner_point> &points)
+{
+    // indices, because points grows while searching
+    int64_t best = -1;
+    uint64_t pass_qd = 0, fail_qd = 0;
+
+    for (uint64_t qd = 1; qd <= max_queue_depth; qd = next_search_value(qd, max_queue_depth))
+    {
+        points.push_back(measure(params, slo, threads, qd));
+        if (!points.back().meets_slo)
+        {
+            fail_qd = qd;
+            break;
+        }
+        if (best < 0 || points.back().iops > points[best].iops)
+        {
+            best = points.size() - 1;
+        }
+        pass_qd = qd;
+    }
+
+    // bisect until the bracket is within ~12% of the passing depth
+    while (pass_qd && fail_qd && fail_qd - pass_qd > std::max<uint64_t>(1, pass_qd / 8))
+    {
+        uint64_t qd = pass_qd + (fail_qd - pass_qd) / 2;
+        points.push_back(measure(params, slo, threads, qd));
+        if (points.back().meets_slo)
+        {
+            pass_qd = qd;
+            if (points.back().iops > points[best].iops)
+            {
+                best = points.size() - 1;
+            }
+        }
+        else
+        {
+            fail_qd = qd;
+        }
+    }
+
+    return best < 0 ? nullptr : &points[best];
+}
+
+void run_find_max_iops(benchmark_params &params)
+{
+    latency_slo slo = parse_slo(params.slo);
+    uint64_t max_threads = params.threads;
+    uint64_t max_queue_depth = params.queue_depth;
+
+    std::cout << "Searching for the highest IOPS with p" << slo.percentile << " <= " << slo.latency_ns / 1e3
+              << " us (threads <= " << max_threads << ", queue depth <= " << max_queue_depth
+              << ", " << params.duration << " s per step)" << std::endl;
+
+    std::vector<tuner_point> points;
+    tuner_point best = {0, 0, 0, 0, 0, 0, latency_histogram(), false};
+
+    for (uint64_t threads = 1; threads <= max_threads; threads = next_search_value(threads, max_threads))
+    {
+        const tuner_point *found = search_queue_depth(params, slo, threads, max_queue_depth, points);
+        if (!found)
+        {
+            // already over the SLO at queue depth 1: more threads only add queueing
+            break;
+        }
+        if (found->iops <= best.iops)
+        {
+            break;
+        }
+        best = *found;
+    }
+
+    params.threads = max_threads;
+    params.queue_depth = max_queue_depth;
+
+    // knee: highest IOPS per unit of latency
+    tuner_point knee = points.front();
+    for (const auto &point : points)
+    {
+        if (point.iops / std::max<uint64_t>(point.slo_latency_ns, 1) > knee.iops / std::max<uint64_t>(knee.slo_latency_ns, 1))
+        {
+            knee = point;
+        }
+    }
+
+    std::sort(points.begin(), points.end(), [](const tuner_point &a, const tuner_point &b) {
+        return a.threads != b.threads ? a.threads < b.threads : a.queue_depth < b.queue_depth;
+    });
+
+    std::ostringstream label;
+    label << "p" << slo.percentile;
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(2);
+    report << "Latency/Throughput Curve (" << label.str() << "):\n"
+           << std::setw(8) << "Threads" << std::setw(8) << "QD" << std::setw(14) << "IOPS" << std::setw(14) << "Latency us" << "\n";
+    for (const auto &point : points)
+    {
+        report << std::setw(8) << point.threads << std::setw(8) << point.queue_depth
+               << std::setw(14) << point.iops << std::setw(14) << point.slo_latency_ns / 1e3
+               << (point.meets_slo ? "" : "  over SLO") << "\n";
+    }
+    report << "Knee: Threads " << knee.threads << ", QD " << knee.queue_depth << ", " << knee.iops
+           << " IOPS, " << label.str() << " " << knee.slo_latency_ns / 1e3 << " us\n";
+    std::cout << report.str();
+
+    if (best.io_completed == 0)
+    {
+        std::cout << "No configuration meets the SLO." << std::endl;
+        return;
+    }
+
+    std::cout << "Max IOPS within SLO: Threads " << best.threads << ", QD " << best.queue_depth << std::endl;
+    print_latency_summary("Latency", best.latency);
+
+    double data_size_MB = double(best.io_completed) * params.page_size / (KILO * KILO);
+    std::cout << "Total I/O Completed: " << best.io_completed
+              << "\nTotal Data Size: " << data_size_MB << " MB"
+              << "\nTotal Time: " << best.seconds << " seconds"
+              << "\nThroughput: " << best.iops << " IOPS"
+              << "\nBandwidth: " << data_size_MB / best.seconds << " MB/s" << std::endl;
+}
+
+void run_size_sweep(benchmark_params &params)
+{
+    std::cout << "Working-set sweep: " << params.size_sweep.size() << " sizes from "
+              << byte_conversion(params.region_offset, "binary") << ", " << params.duration << " s each" << std::endl;
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(2);
+    report << std::setw(12) << "Size" << std::setw(14) << "IOPS" << std::setw(12) << "MB/s"
+           << std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << std::setw(12) << "p99.9 us" << "\n";
+
+    for (uint64_t size : params.size_sweep)
+    {
+        params.region_size = size;
+        params.total_num_pages = size / params.page_size;
+        step_result step = run_step(params);
+
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(2)
+             << std::setw(12) << byte_conversion(size, "binary")
+             << std::setw(14) << step.iops
+             << std::setw(12) << step.iops * params.page_size / (KILO * KILO)
+             << std::setw(12) << step.latency.percentile(50) / 1e3
+             << std::setw(12) << step.latency.percentile(99) / 1e3
+             << std::setw(12) << step.latency.percentile(99.9) / 1e3;
+        std::cout << "Step:" << line.str() << std::endl;
+        report << line.str() << "\n";
+    }
+
+    std::cout << "Working-Set Sweep:\n" << report.str();
+}
+
+// Process CPU seconds (user + system), including the kernel's io-wq workers
+static double cpu_seconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+void run_thread_sweep(benchmark_params &params)
+{
+    // the configured sharing mode is measured next to the strict ring-per-thread baseline
+    bool sharing = params.attach_wq || params.submitters > 1;
+    std::string mode = params.submitters > 1 ? std::to_string(params.submitters) + "/ring" : "attach_wq";
+    if (params.submitters > 1 && params.attach_wq)
+    {
+        mode += "+wq";
+    }
+    int wq_fd = params.wq_fd;
+    uint64_t submitters = params.submitters;
+
+    std::cout << "Thread sweep: " << params.thread_sweep.size() << " thread counts, "
+              << (sharing ? "ring-per-thread and " + mode : std::string("ring-per-thread")) << ", "
+              << params.duration << " s each" << std::endl;
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(2);
+    report << std::setw(8) << "Threads" << std::setw(16) << "Mode" << std::setw(14) << "IOPS" << std::setw(12) << "MB/s"
+           << std::setw(12) << "p99 us" << std::setw(10) << "Cores" << std::setw(12) << "CPU us/IO"
+           << std::setw(12) << "IOPS/core" << "\n";
+
+    for (uint64_t threads : params.thread_sweep)
+    {
+        params.threads = threads;
+        for (bool shared : {false, true})
+        {
+            if (shared && !sharing)
+            {
+                break;
+            }
+            params.wq_fd = shared ? wq_fd : -1;
+            params.submitters = shared ? submitters : 1;
+
+            double cpu_start = cpu_seconds();
+            step_result step = run_step(params);
+            double cpu = cpu_seconds() - cpu_start;
+
+            std::ostringstream line;
+            line << std::fixed << std::setprecision(2)
+                 << std::setw(8) << threads
+                 << std::setw(16) << (shared ? mode : "ring/thread")
+                 << std::setw(14) << step.iops
+                 << std::setw(12) << step.iops * params.page_size / (KILO * KILO)
+                 << std::setw(12) << step.latency.percentile(99) / 1e3
+                 << std::setw(10) << (step.seconds > 0 ? cpu / step.seconds : 0)
+                 << std::setw(12) << (step.io_completed ? cpu * 1e6 / step.io_completed : 0)
+                 << std::setw(12) << (cpu > 0 ? step.io_completed / cpu : 0);
+            std::cout << "Step:" << line.str() << std::endl;
+            report << line.str() << "\n";
+        }
+    }
+    params.wq_fd = wq_fd;
+    params.submitters = submitters;
+
+    std::cout << "Thread Sweep:\n" << report.str();
+}
+
+bool run_repeat(benchmark_params &params)
+{
+    std::cout << "Repeat: " << params.repeat << " runs of " << params.duration << " s" << std::endl;
+
+    // a percentile moves in steps of one histogram bucket, up to 1 / sub_buckets of its value
+    double bucket_width = 1.0 / latency_histogram::sub_buckets;
+    std::vector<metric_series> metrics = {
+        {"iops", "IOPS", true, {}},
+        {"bandwidth_mbps", "MB/s", true, {}},
+        {"latency_mean_us", "Mean us", false, {}},
+        {"latency_p50_us", "p50 us", false, {}, bucket_width},
+        {"latency_p99_us", "p99 us", false, {}, bucket_width},
+        {"latency_p999_us", "p99.9 us", false, {}, bucket_width},
+        {"cpu_us_per_io", "CPU us/IO", false, {}},
+    };
+
+    for (uint64_t run = 1; run <= params.repeat; run++)
+    {
+        double cpu_start = cpu_seconds();
+        step_result step = run_step(params);
+        double cpu = cpu_seconds() - cpu_start;
+
+        std::vector<double> values = {
+            step.iops,
+            step.iops * params.page_size / (KILO * KILO),
+            step.latency.mean() / 1e3,
+            step.latency.percentile(50) / 1e3,
+            step.latency.percentile(99) / 1e3,
+            step.latency.percentile(99.9) / 1e3,
+            step.io_completed ? cpu * 1e6 / step.io_completed : 0,
+        };
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(2) << std::setw(6) << run;
+        for (size_t i = 0; i < metrics.size(); i++)
+        {
+            metrics[i].values.push_back(values[i]);
+            line << "  " << metrics[i].label << " " << values[i];
+        }
+        std::cout << "Step:" << line.str() << std::endl;
+    }
+
+    print_repeat_summary(metrics, params.repeat);
+    if (!params.json_path.empty())
+    {
+        write_baseline(params.json_path, params, metrics);
+    }
+    return !params.compare_path.empty() && compare_with_baseline(params.compare_path, params, metrics) > 0;
+}
@@ -0,0 +1,444 @@
+#include "verify.h"
+#include <iomanip>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Error messages printed per thread before only counting
+static constexpr uint64_t max_printed_errors = 10;
+
+static inline uint64_t read64(const uint8_t *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// ---- CRC-32C ----
+
+static uint32_t crc32c_table[256];
+
+static bool init_crc32c_table()
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+        }
+        crc32c_table[i] = crc;
+    }
+    return true;
+}
+
+static uint32_t crc32c_software(const uint8_t *p, size_t length, uint32_t crc)
+{
+    static const bool initialised = init_crc32c_table();
+    (void)initialised;
+    while (length--)
+    {
+        crc = crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) static uint32_t crc32c_sse42(const uint8_t *p, size_t length, uint32_t crc)
+{
+    uint64_t crc64 = crc;
+    for (; length >= 8; p += 8, length -= 8)
+    {
+        crc64 = _mm_crc32_u64(crc64, read64(p));
+    }
+    crc = static_cast<uint32_t>(crc64);
+    while (length--)
+    {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+uint32_t crc32c(const void *data, size_t length, uint32_t crc)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+#if defined(__x86_64__)
+    static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+    if (has_sse42)
+    {
+        return ~crc32c_sse42(p, length, ~crc);
+    }
+#endif
+    return ~crc32c_software(p, length, ~crc);
+}
+
+// ---- XXH3-64, long inputs (> 240 bytes), default secret, seed 0 ----
+
+static constexpr uint64_t XXH_PRIME32_1 = 0x9E3779B1U;
+static constexpr uint64_t XXH_PRIME32_2 = 0x85EBCA77U;
+static constexpr uint64_t XXH_PRIME32_3 = 0xC2B2AE3DU;
+static constexpr uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+static constexpr uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static constexpr size_t XXH_STRIPE_LEN = 64;
+static constexpr size_t XXH_SECRET_CONSUME_RATE = 8;
+static constexpr size_t XXH_SECRET_SIZE = 192;
+static constexpr size_t XXH_SECRET_LASTACC_START = 7;
+static constexpr size_t XXH_SECRET_MERGEACCS_START = 11;
+
+alignas(64) static const uint8_t xxh3_secret[XXH_SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static void xxh3_accumulate_scalar(uint64_t *acc, const uint8_t *input, const uint8_t *secret, size_t stripes)
+{
+    for (size_t s = 0; s < stripes; s++)
+    {
+        const uint8_t *stripe = input + s * XXH_STRIPE_LEN;
+        const uint8_t *key = secret + s * XXH_SECRET_CONSUME_RATE;
+        for (int i = 0; i < 8; i++)
+        {
+            uint64_t data_val = read64(stripe + 8 * i);
+            uint64_t data_key = data_val ^ read64(key + 8 * i);
+            acc[i ^ 1] += data_val;
+            acc[i] += (data_key & 0xFFFFFFFF) * (data_key >> 32);
+        }
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) static void xxh3_accumulate_avx2(uint64_t *acc, const uint8_t *input,
+                                                                  const uint8_t *secret, size_t stripes)
+{
+    __m256i acc_vec[2] = {_mm256_loadu_si256(reinterpret_cast<const __m256i *>(acc)),
+                          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(acc + 4))};
+    for (size_t s = 0; s < stripes; s++)
+    {
+        const uint8_t *stripe = input + s * XXH_STRIPE_LEN;
+        const uint8_t *key = secret + s * XXH_SECRET_CONSUME_RATE;
+        for (int i = 0; i < 2; i++)
+        {
+            __m256i data_vec = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(stripe + 32 * i));
+            __m256i key_vec = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(key + 32 * i));
+            __m256i data_key = _mm256_xor_si256(data_vec, key_vec);
+            // low 32 bits times high 32 bits of every 64-bit lane
+            __m256i data_key_hi = _mm256_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+            __m256i product = _mm256_mul_epu32(data_key, data_key_hi);
+            // acc[i ^ 1] += data: swap the 64-bit lanes of every 128-bit half
+            __m256i data_swap = _mm256_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+            acc_vec[i] = _mm256_add_epi64(acc_vec[i], _mm256_add_epi64(product, data_swap));
+        }
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc), acc_vec[0]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc + 4), acc_vec[1]);
+}
+#endif
+
+static void xxh3_accumulate(uint64_t *acc, const uint8_t *input, const uint8_t *secret, size_t stripes)
+{
+#if defined(__x86_64__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2)
+    {
+        xxh3_accumulate_avx2(acc, input, secret, stripes);
+        return;
+    }
+#endif
+    xxh3_accumulate_scalar(acc, input, secret, stripes);
+}
+
+static void xxh3_scramble(uint64_t *acc, const uint8_t *secret)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        uint64_t value = acc[i];
+        value ^= value >> 47;
+        value ^= read64(secret + 8 * i);
+        acc[i] = value * XXH_PRIME32_1;
+    }
+}
+
+static uint64_t mul128_fold64(uint64_t lhs, uint64_t rhs)
+{
+    __uint128_t product = static_cast<__uint128_t>(lhs) * rhs;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+uint64_t xxh3_64(const void *data, size_t length)
+{
+    const uint8_t *input = static_cast<const uint8_t *>(data);
+    const uint8_t *secret = xxh3_secret;
+    uint64_t acc[8] = {XXH_PRIME32_3, XXH_PRIME64_1, XXH_PRIME64_2, XXH_PRIME64_3,
+                       XXH_PRIME64_4, XXH_PRIME32_2, XXH_PRIME64_5, XXH_PRIME32_1};
+
+    const size_t stripes_per_block = (XXH_SECRET_SIZE - XXH_STRIPE_LEN) / XXH_SECRET_CONSUME_RATE;
+    const size_t block_length = XXH_STRIPE_LEN * stripes_per_block;
+    const size_t blocks = (length - 1) / block_length;
+
+    for (size_t n = 0; n < blocks; n++)
+    {
+        xxh3_accumulate(acc, input + n * block_length, secret, stripes_per_block);
+        xxh3_scramble(acc, secret + XXH_SECRET_SIZE - XXH_STRIPE_LEN);
+    }
+
+    // last partial block, then the last stripe of the input with its own secret offset
+    size_t stripes = ((length - 1) - block_length * blocks) / XXH_STRIPE_LEN;
+    xxh3_accumulate(acc, input + blocks * block_length, secret, stripes);
+    xxh3_accumulate_scalar(acc, input + length - XXH_STRIPE_LEN,
+                           secret + XXH_SECRET_SIZE - XXH_STRIPE_LEN - XXH_SECRET_LASTACC_START, 1);
+
+    uint64_t result = length * XXH_PRIME64_1;
+    for (int i = 0; i < 4; i++)
+    {
+        const uint8_t *key = secret + XXH_SECRET_MERGEACCS_START + 16 * i;
+        result += mul128_fold64(acc[2 * i] ^ read64(key), acc[2 * i + 1] ^ read64(key + 8));
+    }
+
+    // avalanche
+    result ^= result >> 37;
+    result *= 0x165667919E3779F9ULL;
+    result ^= result >> 32;
+    return result;
+}
+
+// ---- block stamping and checking ----
+
+static uint64_t block_checksum(verify_algorithm algorithm, const char *block, uint64_t length)
+{
+    return algorithm == verify_algorithm::crc32c ? crc32c(block, length) : xxh3_64(block, length);
+}
+
+verify_algorithm parse_verify(const std::string &name)
+{
+    if (name == "crc32c")
+    {
+        return verify_algorithm::crc32c;
+    }
+    if (name == "xxh3")
+    {
+        return verify_algorithm::xxh3;
+    }
+    throw std::invalid_argument("unknown algorithm '" + name + "' (use crc32c or xxh3)");
+}
+
+void verify_prepare_buffer(const benchmark_params &params, char *buffer, uint64_t size)
+{
+    if (params.verify == verify_algorithm::none || params.read_or_write != "write")
+    {
+        return;
+    }
+    std::mt19937_64 rng(params.verify_seed ^ reinterpret_cast<uintptr_t>(buffer));
+    for (uint64_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t value = rng();
+        memcpy(buffer + i, &value, sizeof(value));
+    }
+}
+
+void verify_stamp_block(const benchmark_params &params, thread_stats &stats, char *block, uint64_t offset, uint16_t thread_id)
+{
+    uint64_t start = get_current_time_ns();
+    uint64_t sequence = ++stats.verify_blocks;
+
+    verify_header header = {VERIFY_MAGIC, offset, sequence, params.verify_seed, static_cast<uint32_t>(params.page_size),
+                            static_cast<uint16_t>(params.verify), thread_id};
+    memcpy(block, &header, sizeof(header));
+    for (uint64_t sector = VERIFY_SECTOR; sector < static_cast<uint64_t>(params.page_size); sector += VERIFY_SECTOR)
+    {
+        memcpy(block + sector, &sequence, sizeof(sequence));
+    }
+    uint64_t checksum = block_checksum(params.verify, block, params.page_size - sizeof(checksum));
+    memcpy(block + params.page_size - sizeof(checksum), &checksum, sizeof(checksum));
+
+    if (params.written_pages)
+    {
+        uint64_t page = (offset - params.region_offset) / params.page_size;
+        params.written_pages[page / 64].fetch_or(1ULL << (page % 64), std::memory_order_relaxed);
+    }
+    stats.verify_ns += get_current_time_ns() - start;
+}
+
+// Empty when the block is intact; seed 0 accepts blocks of any run
+static std::string check_block(verify_algorithm algorithm, const char *block, uint32_t size, uint64_t offset, uint64_t seed)
+{
+    verify_header header;
+    memcpy(&header, block, sizeof(header));
+    if (header.magic != VERIFY_MAGIC)
+    {
+        return "no verify header (block not written with --verify)";
+    }
+
+    uint64_t stored;
+    memcpy(&stored, block + size - sizeof(stored), sizeof(stored));
+    if (header.block_size != size || header.algorithm != static_cast<uint16_t>(algorithm))
+    {
+        return "written with a different page size or --verify algorithm";
+    }
+    if (block_checksum(algorithm, block, size - sizeof(stored)) != stored)
+    {
+        // a torn write leaves sectors of an older write behind
+        for (uint32_t sector = 1; sector < size / VERIFY_SECTOR; sector++)
+        {
+            uint64_t sequence;
+            memcpy(&sequence, block + sector * VERIFY_SECTOR, sizeof(sequence));
+            if (sequence != header.sequence)
+            {
+                return "torn write: sector " + std::to_string(sector) + " has sequence " + std::to_string(sequence) +
+                       ", header " + std::to_string(header.sequence);
+            }
+        }
+        return "checksum mismatch (corrupted data)";
+    }
+    if (header.offset != offset)
+    {
+        return "misdirected write: block was written for offset " + std::to_string(header.offset);
+    }
+    if (seed && header.seed != seed)
+    {
+        return "stale block from an earlier run";
+    }
+    return "";
+}
+
+static void report_error(uint64_t &errors, uint64_t offset, const std::string &error)
+{
+    if (++errors <= max_printed_errors)
+    {
+        std::cerr << "Verify error at offset " << offset << ": " << error << "\n";
+    }
+}
+
+void verify_check_block(verify_algorithm algorithm, thread_stats &stats, const char *block, uint32_t size, uint64_t offset)
+{
+    uint64_t start = get_current_time_ns();
+    stats.verify_blocks++;
+    std::string error = check_block(algorithm, block, size, offset, 0);
+    if (!error.empty())
+    {
+        report_error(stats.verify_errors, offset, error);
+    }
+    stats.verify_ns += get_current_time_ns() - start;
+}
+
+void verify_track_writes(benchmark_params &params)
+{
+    uint64_t words = (params.region_size / params.page_size + 63) / 64;
+    params.written_pages = new std::atomic<uint64_t>[words]();
+}
+
+verify_pass_result run_verify_pass(benchmark_params &params)
+{
+    uint64_t words = (params.region_size / params.page_size + 63) / 64;
+    std::vector<verify_pass_result> results(params.threads);
+    uint64_t start = get_current_time_ns();
+
+    // one bitmap word (up to 64 pages) at a time, round robin over the threads;
+    // every run of consecutive written pages is one read
+    auto verify_thread = [&](uint64_t thread_id) {
+        char *buffer = nullptr;
+        if (posix_memalign((void **)&buffer, params.page_size, 64 * params.page_size) != 0)
+        {
+            throw std::runtime_error("Error allocating buffer: " + std::string(strerror(errno)));
+        }
+        verify_pass_result &result = results[thread_id];
+
+        for (uint64_t word = thread_id; word < words; word += params.threads)
+        {
+            uint64_t bits = params.written_pages[word].load(std::memory_order_relaxed);
+            while (bits)
+            {
+                uint64_t first = __builtin_ctzll(bits);
+                uint64_t shifted = bits >> first;
+                uint64_t run = (~shifted == 0) ? 64 : __builtin_ctzll(~shifted);
+                bits &= ~((run == 64 ? ~0ULL : (1ULL << run) - 1) << first);
+
+                uint64_t offset = params.region_offset + (word * 64 + first) * params.page_size;
+                uint64_t length = run * params.page_size;
+                if (pread(params.fd, buffer, length, offset) != static_cast<ssize_t>(length))
+                {
+                    report_error(result.errors, offset, "read failed: " + std::string(strerror(errno)));
+                    continue;
+                }
+                for (uint64_t i = 0; i < run; i++)
+                {
+                    uint64_t block_offset = offset + i * params.page_size;
+                    std::string error = check_block(params.verify, buffer + i * params.page_size, params.page_size,
+                                                    block_offset, params.verify_seed);
+                    if (!error.empty())
+                    {
+                        report_error(result.errors, block_offset, error);
+                    }
+                }
+                result.blocks += run;
+            }
+        }
+        free(buffer);
+    };
+
+    std::vector<std::thread> threads;
+    for (uint64_t i = 0; i < params.threads; i++)
+    {
+        threads.push_back(std::thread(verify_thread, i));
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    delete[] params.written_pages;
+    params.written_pages = nullptr;
+
+    verify_pass_result total;
+    for (const auto &result : results)
+    {
+        total.blocks += result.blocks;
+        total.errors += result.errors;
+    }
+    total.seconds = (get_current_time_ns() - start) / 1e9;
+    return total;
+}
+
+uint64_t print_verify_summary(const benchmark_params &params, const std::vector<thread_stats> &thread_stats_list,
+                              const verify_pass_result &pass)
+{
+    uint64_t blocks = 0, errors = 0, verify_ns = 0, thread_ns = 0;
+    for (const auto &stats : thread_stats_list)
+    {
+        blocks += stats.verify_blocks;
+        errors += stats.verify_errors;
+        verify_ns += stats.verify_ns;
+        thread_ns += stats.end_time - stats.start_time;
+    }
+
+    bool writing = params.read_or_write == "write";
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << "Verify (" << (params.verify == verify_algorithm::crc32c ? "crc32c" : "xxh3") << "): " << blocks
+        << (writing ? " blocks stamped" : " blocks checked, " + std::to_string(errors) + " errors")
+        << ", " << verify_ns / 1e9 << " s of thread time (" << (thread_ns ? 100.0 * verify_ns / thread_ns : 0)
+        << "%), " << (verify_ns ? double(blocks) * params.page_size / verify_ns : 0) << " GB/s per thread\n";
+    if (writing)
+    {
+        double MB = double(pass.blocks) * params.page_size / (KILO * KILO);
+        out << "Verify Pass: " << pass.blocks << " blocks read back in " << pass.seconds << " s ("
+            << (pass.seconds > 0 ? MB / pass.seconds : 0) << " MB/s), " << pass.errors << " errors\n";
+        errors += pass.errors;
+    }
+    std::cout << out.str() << std::flush;
+    return errors;
+}
@@ -0,0 +1,353 @@
+#include "wal.h"
+#include "iou.h"
+#include "async.h"
+#include <condition_variable>
+
+static constexpr uint64_t wal_buffer_size = 4 * KIBI * KIBI; // per half of the double buffer
+
+struct wal_log
+{
+    std::mutex mutex;
+    std::condition_variable pending_cv; // committer waits for records
+    std::condition_variable durable_cv; // producers wait for their record to be flushed
+    std::condition_variable space_cv;   // producers wait for room in the active buffer
+
+    char *buffers[2] = {nullptr, nullptr};
+    int active = 0;
+    uint64_t active_used = 0;
+    uint64_t active_records = 0;
+    uint64_t first_pending_time = 0;
+
+    uint64_t appended_lsn = 0; // records appended so far
+    uint64_t durable_lsn = 0;  // records flushed so far
+    bool running = true;
+
+    // committer statistics
+    uint64_t flushes = 0;
+    uint64_t bytes_written = 0;
+    uint64_t records_flushed = 0;
+    uint64_t min_flush_bytes = UINT64_MAX;
+    uint64_t max_flush_bytes = 0;
+    latency_histogram flush_latency; // write + flush of one group
+};
+
+// Header written in front of every record so a log dump is self-describing
+struct wal_record_header
+{
+    uint64_t lsn;
+    uint32_t producer;
+    uint32_t length;
+};
+
+static void wal_producer_thread(benchmark_params &params, wal_log &log, thread_stats &stats, uint64_t thread_id)
+{
+    pin_thread(thread_id);
+
+    std::vector<char> record(params.wal_record_size, static_cast<char>('a' + thread_id % 26));
+    wal_record_header header = {0, static_cast<uint32_t>(thread_id), static_cast<uint32_t>(params.wal_record_size)};
+
+    stats.start_time = get_current_time_ns();
+
+    while (true)
+    {
+        uint64_t current_time = get_current_time_ns();
+        if (current_time - stats.start_time >= params.duration * 1e9)
+        {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(log.mutex);
+        log.space_cv.wait(lock, [&]() { return log.active_used + params.wal_record_size <= wal_buffer_size; });
+
+        uint64_t lsn = ++log.appended_lsn;
+        header.lsn = lsn;
+        memcpy(record.data(), &header, std::min(sizeof(header), record.size()));
+        memcpy(log.buffers[log.active] + log.active_used, record.data(), record.size());
+        log.active_used += record.size();
+
+        // the first record starts the group timeout, the last one completes the group
+        if (log.active_records++ == 0)
+        {
+            log.first_pending_time = current_time;
+            log.pending_cv.notify_one();
+        }
+        else if (log.active_records >= params.wal_group_size)
+        {
+            log.pending_cv.notify_one();
+        }
+
+        log.durable_cv.wait(lock, [&]() { return log.durable_lsn >= lsn; });
+        lock.unlock();
+
+        stats.latency.record(get_current_time_ns() - current_time);
+        stats.bytes_completed += params.wal_record_size;
+        stats.io_completed++;
+    }
+
+    stats.end_time = get_current_time_ns();
+}
+
+// Writes one group at `offset` and makes it durable with the selected engine
+struct wal_writer
+{
+    benchmark_params &params;
+    struct io_uring ring;          // liburing
+    struct submitter *s = nullptr; // io_uring
+    struct io_data write_io, flush_io;
+    thread_stats ring_stats;       // completion counters for reap_cqes
+    bool buffer_free = true;
+
+    explicit wal_writer(benchmark_params &p) : params(p)
+    {
+        if (params.engine == "liburing")
+        {
+            init_liburing_ring(params, &ring, 2);
+        }
+        if (params.engine == "io_uring")
+        {
+            s = new submitter();
+            if (app_setup_uring(s, 2, params.wq_fd))
+            {
+                throw std::runtime_error("Error setting up io_uring");
+            }
+        }
+    }
+
+    ~wal_writer()
+    {
+        if (params.engine == "liburing")
+        {
+            io_uring_queue_exit(&ring);
+        }
+        if (s)
+        {
+            app_teardown_uring(s);
+            delete s;
+        }
+    }
+
+    void write_and_flush(char *buffer, uint64_t length, uint64_t offset)
+    {
+        if (params.engine == "sync")
+        {
+            uint64_t done = 0;
+            while (done < length)
+            {
+                ssize_t ret = pwrite(params.fd, buffer + done, length - done, offset + done);
+                if (ret <= 0)
+                {
+                    throw std::runtime_error("WAL write failed: " + std::string(strerror(errno)));
+                }
+                done += ret;
+            }
+            if (fdatasync(params.fd) != 0)
+            {
+                throw std::runtime_error("WAL flush failed: " + std::string(strerror(errno)));
+            }
+        }
+        else if (params.engine == "liburing")
+        {
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+            io_uring_prep_write(sqe, params.fd, buffer, length, offset);
+            io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+            sqe = io_uring_get_sqe(&ring);
+            io_uring_prep_fsync(sqe, params.fd, IORING_FSYNC_DATASYNC);
+
+            int ret = io_uring_submit_and_wait(&ring, 2);
+            if (ret < 0)
+            {
+                throw std::runtime_error("io_uring_submit failed: " + std::string(strerror(-ret)));
+            }
+            for (int i = 0; i < 2; i++)
+            {
+                struct io_uring_cqe *cqe;
+                io_uring_wait_cqe(&ring, &cqe);
+                if (cqe->res < 0)
+                {
+                    throw std::runtime_error("WAL write or flush failed: " + std::string(strerror(-cqe->res)));
+                }
+                io_uring_cqe_seen(&ring, cqe);
+            }
+        }
+        else
+        {
+            uint64_t flushes = ring_stats.flushes_completed;
+            struct io_uring_sqe *sqe = submit_io(s, params.fd, length, offset, false, &write_io, buffer, 0, 0);
+            sqe->flags |= IOSQE_IO_LINK;
+            submit_flush(s, params.fd, true, &flush_io);
+
+            unsigned to_submit = 2;
+            while (ring_stats.flushes_completed == flushes)
+            {
+                int ret = io_uring_enter(s->ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL);
+                if (ret < 0)
+                {
+                    throw std::runtime_error("io_uring_enter failed: " + std::string(strerror(-ret)));
+                }
+                to_submit = 0;
+                reap_cqes(s, ring_stats, &buffer_free);
+            }
+
+            // a failed or short write cancels the linked flush
+            int32_t res = write_io.result < 0 ? write_io.result : flush_io.result;
+            if (res < 0 || static_cast<uint64_t>(write_io.result) != length)
+            {
+                throw std::runtime_error("WAL write or flush failed: " + std::string(res < 0 ? strerror(-res) : "short write"));
+            }
+        }
+    }
+};
+
+static void wal_committer_thread(benchmark_params &params, wal_log &log)
+{
+    pin_thread(params.threads);
+
+    wal_writer writer(params);
+    uint64_t tail = 0;
+    uint64_t timeout_ns = params.wal_group_timeout_us * KILO;
+
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(log.mutex);
+
+        // wait for a full group, the oldest record's timeout, or shutdown
+        while (true)
+        {
+            if (!log.running)
+            {
+                // flush whatever partial group is left instead of waiting for it to fill
+                if (log.active_records == 0)
+                {
+                    return;
+                }
+                break;
+            }
+            if (log.active_records >= params.wal_group_size)
+            {
+                break;
+            }
+            if (log.active_records > 0)
+            {
+                uint64_t deadline = log.first_pending_time + timeout_ns;
+                uint64_t now = get_current_time_ns();
+                if (now >= deadline)
+                {
+                    break;
+                }
+                log.pending_cv.wait_for(lock, std::chrono::nanoseconds(deadline - now));
+            }
+            else
+            {
+                log.pending_cv.wait(lock);
+            }
+        }
+
+        // swap halves: producers keep appending to the other buffer during the flush
+        char *buffer = log.buffers[log.active];
+        uint64_t length = log.active_used;
+        uint64_t records = log.active_records;
+        uint64_t end_lsn = log.appended_lsn;
+        log.active ^= 1;
+        log.active_used = 0;
+        log.active_records = 0;
+        log.space_cv.notify_all();
+        lock.unlock();
+
+        // O_DIRECT writes whole pages; the padding is part of the log
+        uint64_t padded = (length + params.page_size - 1) / params.page_size * params.page_size;
+        memset(buffer + length, 0, padded - length);
+        if (tail + padded > params.region_size)
+        {
+            tail = 0;
+        }
+
+        uint64_t start = get_current_time_ns();
+        writer.write_and_flush(buffer, padded, params.region_offset + tail);
+        uint64_t end = get_current_time_ns();
+        tail += padded;
+
+        lock.lock();
+        log.durable_lsn = end_lsn;
+        log.flushes++;
+        log.bytes_written += padded;
+        log.records_flushed += records;
+        log.min_flush_bytes = std::min(log.min_flush_bytes, padded);
+        log.max_flush_bytes = std::max(log.max_flush_bytes, padded);
+        log.flush_latency.record(end - start);
+        log.durable_cv.notify_all();
+    }
+}
+
+wal_summary run_wal_workload(benchmark_params &params, std::vector<thread_stats> &thread_stats_list)
+{
+    wal_log log;
+    for (auto &buffer : log.buffers)
+    {
+        // one spare page for the padding of a full buffer
+        if (posix_memalign((void **)&buffer, params.page_size, wal_buffer_size + params.page_size) != 0)
+        {
+            throw std::runtime_error("Error allocating buffer: " + std::string(strerror(errno)));
+        }
+    }
+
+    uint64_t start_time = get_current_time_ns();
+    std::thread committer(wal_committer_thread, std::ref(params), std::ref(log));
+
+    std::vector<std::thread> producers;
+    for (uint64_t i = 0; i < params.threads; i++)
+    {
+        producers.emplace_back(wal_producer_thread, std::ref(params), std::ref(log), std::ref(thread_stats_list[i]), i);
+    }
+    for (auto &t : producers)
+    {
+        t.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(log.mutex);
+        log.running = false;
+        log.pending_cv.notify_one();
+    }
+    committer.join();
+
+    for (auto buffer : log.buffers)
+    {
+        free(buffer);
+    }
+
+    wal_summary summary;
+    summary.seconds = (get_current_time_ns() - start_time) / 1e9;
+    summary.flushes = log.flushes;
+    summary.bytes_written = log.bytes_written;
+    summary.records_flushed = log.records_flushed;
+    summary.min_flush_bytes = log.flushes ? log.min_flush_bytes : 0;
+    summary.max_flush_bytes = log.max_flush_bytes;
+    summary.flush_latency = log.flush_latency;
+    return summary;
+}
+
+void print_wal_summary(const benchmark_params &params, const wal_summary &summary,
+                       const std::vector<thread_stats> &thread_stats_list)
+{
+    uint64_t commits = 0;
+    for (const auto &stats : thread_stats_list)
+    {
+        commits += stats.io_completed;
+    }
+
+    std::cout << "WAL: Producers: " << params.threads
+              << ", Record Size: " << params.wal_record_size << " bytes"
+              << ", Group Size: " << params.wal_group_size
+              << ", Group Timeout: " << params.wal_group_timeout_us << " us" << std::endl;
+    std::cout << "WAL Commits: " << commits << " (" << commits / summary.seconds << " commits/s)" << std::endl;
+    std::cout << "WAL Flushes: " << summary.flushes << " (" << summary.flushes / summary.seconds << " flushes/s)";
+    if (summary.flushes)
+    {
+        std::cout << ", Records per Flush: " << double(summary.records_flushed) / summary.flushes
+                  << ", Bytes per Flush: mean " << summary.bytes_written / summary.flushes
+                  << ", min " << summary.min_flush_bytes << ", max " << summary.max_flush_bytes;
+    }
+    std::cout << "\nWAL Bytes Written: " << summary.bytes_written
+              << " (" << summary.bytes_written / summary.seconds / (KILO * KILO) << " MB/s)" << std::endl;
+    print_latency_summary("Group Write+Flush", summary.flush_latency);
+}
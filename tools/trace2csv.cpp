@@ -0,0 +1,89 @@
+#include "trace.h"
+#include <fstream>
+
+// Converts a binary trace written by io_benchmark --trace=<file> to CSV.
+// Times are in nanoseconds relative to the start of tracing.
+//
+// Usage: io_trace2csv <trace file> [csv file]   (CSV goes to stdout without a second argument)
+
+static const char *op_name(uint8_t op)
+{
+    switch (op)
+    {
+    case TRACE_OP_READ:
+        return "read";
+    case TRACE_OP_WRITE:
+        return "write";
+    case TRACE_OP_FLUSH:
+        return "flush";
+    case TRACE_OP_TRIM:
+        return "trim";
+    case TRACE_OP_WRITE_ZEROES:
+        return "write_zeroes";
+    default:
+        return "unknown";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <trace file> [csv file]\n";
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Error: cannot open " << argv[1] << ": " << strerror(errno) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    trace_file_header header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic != TRACE_MAGIC)
+    {
+        std::cerr << "Error: " << argv[1] << " is not an io_benchmark trace\n";
+        return EXIT_FAILURE;
+    }
+    if (header.version != TRACE_VERSION || header.record_size != sizeof(trace_record))
+    {
+        std::cerr << "Error: unsupported trace version " << header.version
+                  << " (record size " << header.record_size << ")\n";
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream file_out;
+    if (argc == 3)
+    {
+        file_out.open(argv[2]);
+        if (!file_out)
+        {
+            std::cerr << "Error: cannot create " << argv[2] << ": " << strerror(errno) << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    std::ostream &out = (argc == 3) ? file_out : std::cout;
+
+    out << "thread,op,offset,size,submit_ns,complete_ns,latency_ns,result\n";
+
+    std::vector<trace_record> records(64 * KIBI);
+    uint64_t total = 0;
+    while (in)
+    {
+        in.read(reinterpret_cast<char *>(records.data()), records.size() * sizeof(trace_record));
+        uint64_t count = in.gcount() / sizeof(trace_record);
+
+        for (uint64_t i = 0; i < count; i++)
+        {
+            const trace_record &r = records[i];
+            uint64_t submit = r.submit_ns - header.start_ns;
+            out << r.thread_id << ',' << op_name(r.op) << ',' << r.offset << ',' << r.size << ','
+                << submit << ',' << submit + r.latency_ns << ',' << r.latency_ns << ',' << r.result << '\n';
+        }
+        total += count;
+    }
+
+    std::cerr << "Converted " << total << " records\n";
+    return EXIT_SUCCESS;
+}